@@ -0,0 +1,49 @@
+#include "allocations.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// every allocation is prefixed with a header that stores its size, so that
+// the number of live bytes can be tracked when it is released.
+#define HEADER_SIZE alignof(std::max_align_t)
+
+static std::atomic<size_t> allocations = 0;
+static std::atomic<size_t> bytes = 0;
+static std::atomic<size_t> live_bytes = 0;
+static std::atomic<size_t> peak_bytes = 0;
+
+static void *counted_allocate(size_t size) {
+  void *ptr = std::malloc(size + HEADER_SIZE);
+  if (!ptr)
+    throw std::bad_alloc();
+  *static_cast<size_t *>(ptr) = size;
+
+  allocations++;
+  bytes += size;
+  size_t live = live_bytes += size;
+  size_t peak = peak_bytes;
+  while (live > peak && !peak_bytes.compare_exchange_weak(peak, live))
+    ;
+  return static_cast<char *>(ptr) + HEADER_SIZE;
+}
+
+static void counted_release(void *ptr) {
+  if (!ptr)
+    return;
+  void *header = static_cast<char *>(ptr) - HEADER_SIZE;
+  live_bytes -= *static_cast<size_t *>(header);
+  std::free(header);
+}
+
+void *operator new(size_t size) { return counted_allocate(size); }
+void *operator new[](size_t size) { return counted_allocate(size); }
+void operator delete(void *ptr) noexcept { counted_release(ptr); }
+void operator delete[](void *ptr) noexcept { counted_release(ptr); }
+void operator delete(void *ptr, size_t) noexcept { counted_release(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { counted_release(ptr); }
+
+AllocationStats allocation_stats() {
+  return {allocations, bytes, live_bytes, peak_bytes};
+}
+
+void reset_allocation_peak() { peak_bytes = live_bytes.load(); }
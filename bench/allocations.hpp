@@ -0,0 +1,18 @@
+#ifndef ALLOCATIONS_H
+#define ALLOCATIONS_H
+
+#include <cstddef>
+
+// global heap statistics, collected by replacing operator new and delete.
+struct AllocationStats {
+  size_t allocations;    // number of calls to operator new.
+  size_t bytes;          // total number of bytes requested.
+  size_t live_bytes;     // bytes currently allocated.
+  size_t peak_bytes;     // highest value of live_bytes since the last reset.
+};
+
+AllocationStats allocation_stats();
+// resets the peak to the currently live bytes.
+void reset_allocation_peak();
+
+#endif
@@ -0,0 +1,204 @@
+#include "project.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// quickbuild compares timestamps in seconds, so files are only touched
+// once a new second has started since the last build.
+#define TOUCH_DELAY_MS 1100
+
+struct Tool {
+  std::string name;
+  std::string build; // run from the root of the project.
+  std::vector<std::string> clean;
+};
+
+struct Timing {
+  double seconds;
+  size_t commands;
+};
+
+static std::string root;
+
+static size_t take_command_count() {
+  std::ifstream log(root + "/" STUB_LOG);
+  size_t lines = 0;
+  std::string line;
+  while (std::getline(log, line))
+    lines++;
+  log.close();
+  std::filesystem::remove(root + "/" STUB_LOG);
+  return lines;
+}
+
+static Timing run_build(Tool const &tool) {
+  take_command_count();
+  std::string command = "cd '" + root + "' && " + tool.build +
+                        " >/dev/null 2>&1";
+  auto start = std::chrono::steady_clock::now();
+  int status = std::system(command.c_str());
+  auto end = std::chrono::steady_clock::now();
+  if (status != 0)
+    std::fprintf(stderr, "warning: %s exited with %d\n", tool.name.c_str(),
+                 status);
+  return {std::chrono::duration<double>(end - start).count(),
+          take_command_count()};
+}
+
+// rewrites a file, which updates both its mtime and ctime.
+static void touch(std::string const &path) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(TOUCH_DELAY_MS));
+  std::ofstream file(root + "/" + path, std::ios::app);
+  file << "\n";
+}
+
+static void clean(Tool const &tool) {
+  for (std::string const &path : tool.clean)
+    std::filesystem::remove_all(root + "/" + path);
+}
+
+// the median of every run.
+static Timing median(std::vector<Timing> timings) {
+  std::sort(timings.begin(), timings.end(),
+            [](Timing const &a, Timing const &b) {
+              return a.seconds < b.seconds;
+            });
+  return timings[timings.size() / 2];
+}
+
+struct Scenario {
+  char const *name;
+  std::vector<Timing> timings[2];
+};
+
+static bool parse_option(std::string const &arg, char const *name,
+                         size_t &value) {
+  std::string prefix = std::string("--") + name + "=";
+  if (arg.rfind(prefix, 0) != 0)
+    return false;
+  value = std::stoul(arg.substr(prefix.size()));
+  return true;
+}
+
+static bool parse_option(std::string const &arg, char const *name,
+                         std::string &value) {
+  std::string prefix = std::string("--") + name + "=";
+  if (arg.rfind(prefix, 0) != 0)
+    return false;
+  value = arg.substr(prefix.size());
+  return true;
+}
+
+int main(int argc, char **argv) {
+  ProjectShape shape;
+  size_t runs = 3;
+  size_t jobs = std::max(1u, std::thread::hardware_concurrency());
+  std::string quickbuild = "./bin/quickbuild";
+  root = (std::filesystem::temp_directory_path() /
+          ("quickbuild-e2e-" + std::to_string(getpid())))
+             .string();
+  bool keep = false;
+  bool generate_only = false;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (parse_option(arg, "sources", shape.sources) ||
+        parse_option(arg, "headers", shape.headers) ||
+        parse_option(arg, "tasks", shape.tasks) ||
+        parse_option(arg, "fan-in", shape.fan_in) ||
+        parse_option(arg, "fan-out", shape.fan_out) ||
+        parse_option(arg, "depth", shape.depth) ||
+        parse_option(arg, "runs", runs) || parse_option(arg, "jobs", jobs) ||
+        parse_option(arg, "quickbuild", quickbuild) ||
+        parse_option(arg, "dir", root))
+      continue;
+    if (arg == "--keep") {
+      keep = true;
+    } else if (arg == "--generate-only") {
+      generate_only = true;
+    } else {
+      std::printf(
+          "usage: quickbuild-e2e [options]\n"
+          "  --sources=<n>, --headers=<n>, --tasks=<n>: size of the project\n"
+          "  --fan-in=<n>: headers that every object depends on\n"
+          "  --fan-out=<n>: executables that every library is linked into\n"
+          "  --depth=<n>: directories that the sources are nested in\n"
+          "  --runs=<n>: runs of every scenario, the median is reported\n"
+          "  --jobs=<n>: jobs that quickbuild and make are run with\n"
+          "  --quickbuild=<path>: quickbuild binary to benchmark\n"
+          "  --dir=<path>: where the project is generated\n"
+          "  --keep: keeps the project afterwards\n"
+          "  --generate-only: only generates the project\n");
+      return arg == "--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+  if (shape.tasks == 0 || runs == 0) {
+    std::fprintf(stderr, "error: tasks and runs have to be at least 1\n");
+    return EXIT_FAILURE;
+  }
+  shape.sources = std::max(shape.sources, shape.tasks);
+
+  generate_project(root, shape);
+  std::printf("generated %zu sources, %zu headers and %zu libraries in %s\n",
+              shape.sources, shape.headers, shape.tasks, root.c_str());
+  if (generate_only)
+    return EXIT_SUCCESS;
+
+  std::vector<Tool> tools = {
+      {"quickbuild",
+       std::filesystem::absolute(quickbuild).string() + " --log-quiet -j" +
+           std::to_string(jobs),
+       {"obj", "lib", "bin", ".quickbuild", ".quickbuild.bin"}},
+      {"make",
+       "make -s -j" + std::to_string(jobs),
+       {"obj", "lib", "bin"}},
+  };
+
+  // the touched files are in the middle of the project.
+  std::string source = source_path(shape, shape.sources / 2);
+  std::string header = header_path(shape.headers / 2);
+  Scenario scenarios[] = {
+      {"clean build", {}},
+      {"no-op build", {}},
+      {"touch source", {}},
+      {"touch header", {}},
+  };
+  for (size_t run = 0; run < runs; run++) {
+    for (size_t t = 0; t < tools.size(); t++) {
+      clean(tools[t]);
+      scenarios[0].timings[t].push_back(run_build(tools[t]));
+      scenarios[1].timings[t].push_back(run_build(tools[t]));
+      touch(source);
+      scenarios[2].timings[t].push_back(run_build(tools[t]));
+      if (shape.headers > 0) {
+        touch(header);
+        scenarios[3].timings[t].push_back(run_build(tools[t]));
+      }
+    }
+  }
+
+  std::printf("%-14s %12s %10s %12s %10s %8s\n", "scenario", "quickbuild",
+              "commands", "make", "commands", "ratio");
+  for (Scenario const &scenario : scenarios) {
+    if (scenario.timings[0].empty())
+      continue;
+    Timing quickbuild_timing = median(scenario.timings[0]);
+    Timing make_timing = median(scenario.timings[1]);
+    std::printf("%-14s %11.3fs %10zu %11.3fs %10zu %7.2fx\n", scenario.name,
+                quickbuild_timing.seconds, quickbuild_timing.commands,
+                make_timing.seconds, make_timing.commands,
+                quickbuild_timing.seconds / make_timing.seconds);
+  }
+
+  if (!keep)
+    std::filesystem::remove_all(root);
+  return EXIT_SUCCESS;
+}
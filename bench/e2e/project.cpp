@@ -0,0 +1,144 @@
+#include "project.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+// creates its output and logs it, without reading any of its inputs.
+static char const *const STUB_COMPILER =
+    "#!/bin/sh\n"
+    "out=\n"
+    "while [ $# -gt 0 ]; do\n"
+    "  if [ \"$1\" = \"-o\" ]; then out=$2; shift; fi\n"
+    "  shift\n"
+    "done\n"
+    "mkdir -p \"${out%/*}\" && : > \"$out\" && echo \"$out\" >> " STUB_LOG
+    "\n";
+
+std::string source_path(ProjectShape const &shape, size_t source) {
+  size_t library = source % shape.tasks;
+  std::string path = "src/lib_" + std::to_string(library) + "/";
+  size_t index = source / shape.tasks;
+  for (size_t level = 0; level < shape.depth; level++, index /= 4)
+    path += "d" + std::to_string(level) + "_" + std::to_string(index % 4) +
+            "/";
+  return path + "file_" + std::to_string(source) + ".c";
+}
+
+std::string header_path(size_t header) {
+  return "include/h_" + std::to_string(header) + ".h";
+}
+
+static std::string object_path(ProjectShape const &shape, size_t source) {
+  std::string path = source_path(shape, source);
+  return "obj" + path.substr(3, path.size() - 5) + ".o";
+}
+
+static std::string library_path(size_t library) {
+  return "lib/lib_" + std::to_string(library) + ".a";
+}
+
+static std::string executable_path(size_t executable) {
+  return "bin/app_" + std::to_string(executable);
+}
+
+static void write_file(std::filesystem::path const &path,
+                       std::string const &content) {
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file << content;
+}
+
+void generate_project(std::string const &root, ProjectShape const &shape) {
+  std::filesystem::path base(root);
+
+  // the headers of every library, and the libraries of every executable.
+  std::vector<std::vector<size_t>> library_headers(shape.tasks);
+  for (size_t library = 0; library < shape.tasks; library++)
+    for (size_t i = 0; i < shape.fan_in && i < shape.headers; i++)
+      library_headers[library].push_back((library * shape.fan_in + i) %
+                                         shape.headers);
+  std::vector<std::vector<size_t>> executable_libraries(shape.tasks);
+  for (size_t library = 0; library < shape.tasks; library++)
+    for (size_t i = 0; i < shape.fan_out && i < shape.tasks; i++)
+      executable_libraries[(library + i) % shape.tasks].push_back(library);
+  std::vector<std::vector<size_t>> library_sources(shape.tasks);
+  for (size_t source = 0; source < shape.sources; source++)
+    library_sources[source % shape.tasks].push_back(source);
+
+  for (size_t header = 0; header < shape.headers; header++)
+    write_file(base / header_path(header),
+               "int h_" + std::to_string(header) + "(void);\n");
+  for (size_t source = 0; source < shape.sources; source++) {
+    std::string content;
+    for (size_t header : library_headers[source % shape.tasks])
+      content += "#include \"" + header_path(header) + "\"\n";
+    content += "int f_" + std::to_string(source) + "(void) { return 0; }\n";
+    write_file(base / source_path(shape, source), content);
+  }
+  write_file(base / "tools/cc", STUB_COMPILER);
+  std::filesystem::permissions(base / "tools/cc",
+                               std::filesystem::perms::owner_all |
+                                   std::filesystem::perms::group_read |
+                                   std::filesystem::perms::group_exec);
+
+  // quickbuild globs the sources of every library, while make lists them.
+  std::string quickbuild = "cc = \"./tools/cc\";\n\n\"all\" {\n  depends = ";
+  for (size_t executable = 0; executable < shape.tasks; executable++)
+    quickbuild += (executable ? ", \"" : "\"") +
+                  executable_path(executable) + "\"";
+  quickbuild += ";\n  depends_parallel = true;\n}\n";
+  std::string makefile = "CC = ./tools/cc\n\n.PHONY: all\nall:";
+  for (size_t executable = 0; executable < shape.tasks; executable++)
+    makefile += " " + executable_path(executable);
+  makefile += "\n";
+
+  for (size_t executable = 0; executable < shape.tasks; executable++) {
+    std::string libraries;
+    for (size_t library : executable_libraries[executable])
+      libraries += (libraries.empty() ? "" : " ") + library_path(library);
+    std::string dependencies;
+    for (size_t library : executable_libraries[executable])
+      dependencies += std::string(dependencies.empty() ? "" : ", ") + "\"" +
+                      library_path(library) + "\"";
+    quickbuild += "\n\"" + executable_path(executable) +
+                  "\" {\n  depends = " + dependencies +
+                  ";\n  depends_parallel = true;\n  run = \"[cc] -o " +
+                  executable_path(executable) + " " + libraries + "\";\n}\n";
+    makefile += "\n" + executable_path(executable) + ": " + libraries +
+                "\n\t$(CC) -o $@ $^\n";
+  }
+
+  for (size_t library = 0; library < shape.tasks; library++) {
+    std::string k = std::to_string(library);
+    std::string headers;
+    for (size_t header : library_headers[library])
+      headers += std::string(headers.empty() ? "\"" : ", \"") +
+                 header_path(header) + "\"";
+    quickbuild += "\nheaders_" + k + " = " +
+                  (headers.empty() ? "\"\"" : headers) + ";\nsources_" + k +
+                  " = \"src/lib_" + k + "/*.c\";\nobjects_" + k +
+                  " = sources_" + k + ": \"src/*.c\" -> \"obj/*.o\";\n";
+    quickbuild += "objects_" + k + " as obj {\n  source = obj: \"obj/*.o\" "
+                  "-> \"src/*.c\";\n  depends = source, headers_" +
+                  k + ";\n  run = \"[cc] -c [source] -o [obj]\";\n}\n";
+    quickbuild += "\"" + library_path(library) + "\" {\n  depends = objects_" +
+                  k + ";\n  depends_parallel = true;\n  run = \"[cc] -o " +
+                  library_path(library) + " [objects_" + k + "]\";\n}\n";
+
+    makefile += "\nHEADERS_" + k + " :=";
+    for (size_t header : library_headers[library])
+      makefile += " " + header_path(header);
+    makefile += "\n" + library_path(library) + ":";
+    for (size_t source : library_sources[library])
+      makefile += " " + object_path(shape, source);
+    makefile += "\n\t$(CC) -o $@ $^\n";
+    for (size_t source : library_sources[library])
+      makefile += object_path(shape, source) + ": " +
+                  source_path(shape, source) + " $(HEADERS_" + k +
+                  ")\n\t$(CC) -c $< -o $@\n";
+  }
+
+  write_file(base / "quickbuild", quickbuild);
+  write_file(base / "Makefile", makefile);
+}
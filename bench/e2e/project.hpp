@@ -0,0 +1,30 @@
+#ifndef PROJECT_H
+#define PROJECT_H
+
+#include <cstddef>
+#include <string>
+
+// the stub compiler appends the file it wrote to this log, relative to the
+// root of the project, so that the harness can count the commands run.
+#define STUB_LOG ".stub.log"
+
+// the shape of a synthetic project. the sources are split evenly into
+// `tasks` libraries, and every library is linked into `fan_out` of the
+// same number of executables.
+struct ProjectShape {
+  size_t sources = 1000;
+  size_t headers = 100;
+  size_t tasks = 10;
+  size_t fan_in = 10; // headers that every object depends on.
+  size_t fan_out = 2; // executables that every library is linked into.
+  size_t depth = 2;   // directories that the sources are nested in.
+};
+
+// writes the sources, headers, a stub compiler and equivalent `quickbuild`
+// and `Makefile` configs into `root`.
+void generate_project(std::string const &root, ProjectShape const &shape);
+// the path of a source, relative to the root.
+std::string source_path(ProjectShape const &shape, size_t source);
+std::string header_path(size_t header);
+
+#endif
@@ -0,0 +1,107 @@
+#include "../src/arena.hpp"
+#include "../src/compiler.hpp"
+#include "../src/driver.hpp"
+#include "../src/interpreter.hpp"
+#include "../src/lexer.hpp"
+#include "../src/parser.hpp"
+#include "allocations.hpp"
+#include "micro.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// generates a config with `n` objects that are replaced, interpolated and
+// resolved as dependencies. none of the files exist, but they're still
+// stat'ed like in a real build. no commands are run.
+static std::string synthetic_config(size_t n) {
+  std::string config = "compiler = \"cc\";\n"
+                       "flags = \"-O2\", \"-Wall\";\n"
+                       "objects = ";
+  for (size_t i = 0; i < n; i++) {
+    config += "\"obj/file_" + std::to_string(i) + ".o\"";
+    config += (i < n - 1) ? ", " : ";\n";
+  }
+  config += "sources = objects: \"obj/*.o\" -> \"src/*.cpp\";\n"
+            "command = \"[compiler] [flags] [objects] -o bin/output\";\n"
+            "\"all\" {\n"
+            "  depends = sources, command;\n"
+            "}\n";
+  return config;
+}
+
+struct Phase {
+  const char *name;
+  double milliseconds;
+  AllocationStats before;
+  AllocationStats after;
+};
+
+template <typename F> static Phase measure(const char *name, F &&function) {
+  reset_allocation_peak();
+  AllocationStats before = allocation_stats();
+  auto start = std::chrono::steady_clock::now();
+  function();
+  auto end = std::chrono::steady_clock::now();
+  AllocationStats after = allocation_stats();
+  return {name,
+          std::chrono::duration<double, std::milli>(end - start).count(),
+          before, after};
+}
+
+static void print_phase(size_t n, Phase const &phase) {
+  std::printf("%8zu  %-10s %10.2f ms %10zu allocs %10.1f KiB %10.1f KiB\n", n,
+              phase.name, phase.milliseconds,
+              phase.after.allocations - phase.before.allocations,
+              (phase.after.bytes - phase.before.bytes) / 1024.0,
+              (phase.after.peak_bytes - phase.before.live_bytes) / 1024.0);
+}
+
+static void run_pipeline(size_t n) {
+  std::string config = synthetic_config(n);
+  Setup setup = Driver::default_setup();
+  setup.logging_level = LoggingLevel::Quiet;
+
+  Arena ast_arena;
+  Arena value_arena;
+  std::vector<Token> token_stream;
+  AST ast;
+  IRProgram program;
+
+  print_phase(n, measure("lexer", [&]() {
+                Lexer lexer(config);
+                token_stream = lexer.get_token_stream();
+              }));
+  print_phase(n, measure("parser", [&]() {
+                Parser parser(token_stream);
+                ast = parser.parse_tokens();
+              }));
+  print_phase(n, measure("compiler", [&]() {
+                Compiler compiler(ast, ast_arena);
+                program = compiler.compile();
+              }));
+  print_phase(n, measure("evaluate", [&]() {
+                Interpreter interpreter(program, setup, value_arena);
+                interpreter.build();
+              }));
+  std::printf("%8zu  %-10s %10.1f KiB reserved (ast), %.1f KiB reserved "
+              "(values)\n",
+              n, "arenas", ast_arena.bytes_reserved() / 1024.0,
+              value_arena.bytes_reserved() / 1024.0);
+}
+
+// usage: quickbuild-bench [filter]
+// runs the pipeline and every micro-benchmark whose name contains the filter.
+int main(int argc, char **argv) {
+  std::string_view filter = argc > 1 ? argv[1] : "";
+  if (std::string_view("pipeline").find(filter) != std::string_view::npos) {
+    std::printf("%8s  %-10s %13s %17s %14s %14s\n", "n", "phase", "time",
+                "allocations", "allocated", "peak");
+    for (size_t n : {1000, 10000, 50000})
+      run_pipeline(n);
+    std::printf("\n");
+  }
+  run_micro_benchmarks(filter);
+  return 0;
+}
@@ -0,0 +1,201 @@
+#include "micro.hpp"
+#include "../src/arena.hpp"
+#include "../src/compiler.hpp"
+#include "../src/driver.hpp"
+#include "../src/interpreter.hpp"
+#include "../src/lexer.hpp"
+#include "../src/parser.hpp"
+#include "../src/paths.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// a list field with `n` object files, followed by `fields`.
+static std::string list_config(size_t n, std::string const &fields) {
+  std::string config = "objects = ";
+  for (size_t i = 0; i < n; i++) {
+    config += "\"obj/file_" + std::to_string(i) + ".o\"";
+    config += (i < n - 1) ? ", " : ";\n";
+  }
+  return config + fields;
+}
+
+// `n` tasks, each with a field and a command.
+static std::string task_config(size_t n) {
+  std::string config;
+  for (size_t i = 0; i < n; i++)
+    config += "\"task_" + std::to_string(i) +
+              "\" {\n  flags = \"-O2\";\n  run = \"cc [flags]\";\n}\n";
+  return config;
+}
+
+static IRProgram compile(std::string const &config, Arena &arena) {
+  Lexer lexer(config);
+  std::vector<Token> token_stream = lexer.get_token_stream();
+  Parser parser(token_stream);
+  AST ast = parser.parse_tokens();
+  return Compiler(ast, arena).compile();
+}
+
+static Setup quiet_setup() {
+  Setup setup = Driver::default_setup();
+  setup.logging_level = LoggingLevel::Quiet;
+  return setup;
+}
+
+static MicroResult bench_lexer(size_t n) {
+  std::string config = list_config(n, "");
+  return measure_op([&]() {
+    Lexer lexer(config);
+    lexer.get_token_stream();
+  });
+}
+
+static MicroResult bench_parser(size_t n) {
+  std::string config = list_config(n, "");
+  Lexer lexer(config);
+  std::vector<Token> token_stream = lexer.get_token_stream();
+  return measure_op([&]() {
+    Parser parser(token_stream);
+    parser.parse_tokens();
+  });
+}
+
+static MicroResult bench_compiler(size_t n) {
+  std::string config = list_config(n, task_config(n));
+  Lexer lexer(config);
+  std::vector<Token> token_stream = lexer.get_token_stream();
+  Parser parser(token_stream);
+  AST ast = parser.parse_tokens();
+  return measure_op([&]() {
+    Arena arena;
+    Compiler(ast, arena).compile();
+  });
+}
+
+// evaluates a single global field of a fresh interpreter.
+static MicroResult bench_field(std::string const &config,
+                               std::string const &field) {
+  Arena program_arena;
+  IRProgram program = compile(config, program_arena);
+  Setup setup = quiet_setup();
+  return measure_op([&]() {
+    Arena arena;
+    Interpreter interpreter(program, setup, arena);
+    interpreter.evaluate_global(field);
+  });
+}
+
+static MicroResult bench_interpolate(size_t n) {
+  return bench_field(list_config(n, "command = \"cc [objects] -o out\";\n"),
+                     "command");
+}
+
+// the objects are a folded constant, so this only measures the replacement.
+static MicroResult bench_replace(size_t n) {
+  return bench_field(
+      list_config(n, "sources = objects: \"obj/*.o\" -> \"src/*.cpp\";\n"),
+      "sources");
+}
+
+// globs a temporary tree of `n` files, half of which match.
+static MicroResult bench_glob(size_t n) {
+  std::filesystem::path previous = std::filesystem::current_path();
+  std::filesystem::path root = std::filesystem::temp_directory_path() /
+                               ("quickbuild-bench-" + std::to_string(getpid()));
+  for (size_t i = 0; i < n; i++) {
+    std::filesystem::path directory = root / "src" / std::to_string(i % 16);
+    if (i < 16)
+      std::filesystem::create_directories(directory);
+    std::ofstream(directory / ("file_" + std::to_string(i) +
+                               (i % 2 ? ".cpp" : ".hpp")));
+  }
+  std::filesystem::current_path(root);
+  MicroResult result = measure_op([&]() {
+    Arena arena;
+    expand_literal(IString("src/*.cpp", InternalNode{}), true, arena);
+  });
+  std::filesystem::current_path(previous);
+  std::filesystem::remove_all(root);
+  return result;
+}
+
+// the first lookup evaluates every task identifier to build the index.
+static MicroResult bench_task_index(size_t n) {
+  Arena program_arena;
+  IRProgram program = compile(task_config(n), program_arena);
+  Setup setup = quiet_setup();
+  PathId first("task_0");
+  return measure_op([&]() {
+    Arena arena;
+    Interpreter interpreter(program, setup, arena);
+    interpreter.find_task(first);
+  });
+}
+
+// looks up every task once, with the index already built.
+static MicroResult bench_find_task(size_t n) {
+  Arena program_arena;
+  IRProgram program = compile(task_config(n), program_arena);
+  Arena arena;
+  Interpreter interpreter(program, quiet_setup(), arena);
+  std::vector<PathId> identifiers;
+  for (size_t i = 0; i < n; i++)
+    identifiers.emplace_back("task_" + std::to_string(i));
+  interpreter.find_task(identifiers[0]);
+  return measure_op([&]() {
+    for (PathId identifier : identifiers)
+      interpreter.find_task(identifier);
+  });
+}
+
+struct MicroBenchmark {
+  char const *name;
+  std::vector<size_t> sizes;
+  MicroResult (*run)(size_t n);
+};
+
+// `n` is the number of list elements, tasks or files, depending on the
+// benchmark. the scaling is the exponent of the growth since the previous
+// size, so 1.00 is linear.
+void run_micro_benchmarks(std::string_view filter) {
+  std::vector<MicroBenchmark> benchmarks = {
+      {"lexer", {100, 1000, 10000, 100000}, bench_lexer},
+      {"parser", {100, 1000, 10000, 100000}, bench_parser},
+      {"compiler", {100, 1000, 10000, 100000}, bench_compiler},
+      {"interpolate", {100, 1000, 10000, 100000}, bench_interpolate},
+      {"replace", {100, 1000, 10000, 100000}, bench_replace},
+      {"glob", {100, 1000, 10000}, bench_glob},
+      {"task_index", {100, 1000, 10000}, bench_task_index},
+      {"find_task", {100, 1000, 10000}, bench_find_task},
+  };
+
+  std::printf("%-12s %8s %14s %10s %12s %12s %8s\n", "benchmark", "n",
+              "ns/op", "ns/item", "allocs/op", "KiB/op", "scaling");
+  for (MicroBenchmark const &benchmark : benchmarks) {
+    if (std::string_view(benchmark.name).find(filter) == std::string::npos)
+      continue;
+    std::optional<MicroResult> previous;
+    size_t previous_n = 0;
+    for (size_t n : benchmark.sizes) {
+      MicroResult result = benchmark.run(n);
+      char scaling[16] = "-";
+      if (previous)
+        std::snprintf(scaling, sizeof(scaling), "%.2f",
+                      std::log(result.ns_per_op / previous->ns_per_op) /
+                          std::log((double)n / previous_n));
+      std::printf("%-12s %8zu %14.0f %10.1f %12.1f %12.1f %8s\n",
+                  benchmark.name, n, result.ns_per_op, result.ns_per_op / n,
+                  result.allocations_per_op, result.bytes_per_op / 1024.0,
+                  scaling);
+      previous = result;
+      previous_n = n;
+    }
+  }
+}
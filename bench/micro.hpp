@@ -0,0 +1,45 @@
+#ifndef MICRO_H
+#define MICRO_H
+
+#include "allocations.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// every benchmark is repeated until it has run for at least this long.
+#define MICRO_MIN_SECONDS 0.1
+#define MICRO_MAX_ITERATIONS 1000000
+
+struct MicroResult {
+  double ns_per_op;
+  double allocations_per_op;
+  double bytes_per_op;
+};
+
+// runs `op` until enough time has passed, and averages its time and heap
+// usage over every iteration.
+template <typename F> MicroResult measure_op(F &&op) {
+  size_t iterations = 0;
+  double seconds = 0;
+  size_t allocations = 0;
+  size_t bytes = 0;
+  while (seconds < MICRO_MIN_SECONDS && iterations < MICRO_MAX_ITERATIONS) {
+    AllocationStats before = allocation_stats();
+    auto start = std::chrono::steady_clock::now();
+    op();
+    auto end = std::chrono::steady_clock::now();
+    AllocationStats after = allocation_stats();
+    seconds += std::chrono::duration<double>(end - start).count();
+    allocations += after.allocations - before.allocations;
+    bytes += after.bytes - before.bytes;
+    iterations++;
+  }
+  return {seconds * 1e9 / iterations, (double)allocations / iterations,
+          (double)bytes / iterations};
+}
+
+void run_micro_benchmarks(std::string_view filter);
+
+#endif
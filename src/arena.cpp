@@ -0,0 +1,60 @@
+#include "arena.hpp"
+#include <cstdint>
+#include <cstring>
+
+Arena::Arena(size_t block_size) { m_block_size = block_size; }
+
+// objects are destroyed in the reverse order of their construction.
+Arena::~Arena() {
+  for (auto it = m_destructors.rbegin(); it != m_destructors.rend(); it++)
+    it->destroy(it->object);
+}
+
+void *Arena::allocate(size_t size, size_t alignment) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  return _allocate(size, alignment);
+}
+
+// note: expects the lock to be held by the caller.
+void *Arena::_allocate(size_t size, size_t alignment) {
+  m_allocations++;
+  m_bytes_allocated += size;
+
+  // attempt to fit the allocation into the current block.
+  if (!m_blocks.empty()) {
+    Block &block = m_blocks.back();
+    size_t offset = (block.used + alignment - 1) & ~(alignment - 1);
+    if (offset + size <= block.size) {
+      block.used = offset + size;
+      return block.data.get() + offset;
+    }
+  }
+
+  // large allocations get a block of their own, so that the remainder of
+  // the current block isn't wasted.
+  size_t block_size = m_block_size;
+  if (size + alignment > m_block_size / 4)
+    block_size = size + alignment;
+  Block block = {std::unique_ptr<std::byte[]>(new std::byte[block_size]),
+                 block_size, 0};
+  m_bytes_reserved += block_size;
+
+  std::byte *data = block.data.get();
+  size_t offset = (alignment - reinterpret_cast<uintptr_t>(data) % alignment) %
+                  alignment;
+  block.used = offset + size;
+  if (block_size == m_block_size || m_blocks.empty())
+    m_blocks.push_back(std::move(block));
+  else // keep filling the current block after a large allocation.
+    m_blocks.insert(m_blocks.end() - 1, std::move(block));
+  return data + offset;
+}
+
+// copies a string into the arena. the copy is always null-terminated, so
+// that it can be passed directly to the C APIs.
+std::string_view Arena::copy_string(std::string_view string) {
+  char *data = static_cast<char *>(allocate(string.size() + 1, 1));
+  std::memcpy(data, string.data(), string.size());
+  data[string.size()] = '\0';
+  return std::string_view(data, string.size());
+}
@@ -0,0 +1,91 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// default size of a single arena block.
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+// monotonic allocator - memory is only ever released all at once, when the
+// arena itself is destroyed. this is used for objects that live for the
+// entire build, such as tokens, AST nodes and evaluated values.
+class Arena {
+private:
+  struct Block {
+    std::unique_ptr<std::byte[]> data;
+    size_t size;
+    size_t used;
+  };
+  struct Destructor {
+    void *object;
+    void (*destroy)(void *);
+  };
+
+  size_t m_block_size;
+  std::vector<Block> m_blocks;
+  std::vector<Destructor> m_destructors;
+  std::mutex m_lock;
+
+  size_t m_allocations = 0;
+  size_t m_bytes_allocated = 0;
+  size_t m_bytes_reserved = 0;
+
+  void *_allocate(size_t size, size_t alignment);
+
+public:
+  Arena(size_t block_size = ARENA_BLOCK_SIZE);
+  ~Arena();
+  Arena(Arena const &) = delete;
+  Arena &operator=(Arena const &) = delete;
+
+  void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+  std::string_view copy_string(std::string_view string);
+
+  // constructs an object that is destroyed together with the arena.
+  template <typename T, typename... Args> T *make(Args &&...args) {
+    std::lock_guard<std::mutex> guard(m_lock);
+    T *object = new (_allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+    if (!std::is_trivially_destructible<T>::value)
+      m_destructors.push_back(
+          {object, [](void *ptr) { static_cast<T *>(ptr)->~T(); }});
+    return object;
+  }
+
+  size_t allocations() const { return m_allocations; }
+  size_t bytes_allocated() const { return m_bytes_allocated; }
+  size_t bytes_reserved() const { return m_bytes_reserved; }
+};
+
+// allows standard containers to draw their memory from an arena.
+// deallocation is a no-op, so this is best suited for containers that
+// don't grow after they've been constructed.
+template <typename T> struct ArenaAllocator {
+  using value_type = T;
+  Arena *arena;
+
+  ArenaAllocator(Arena &arena) : arena(&arena) {}
+  template <typename U>
+  ArenaAllocator(ArenaAllocator<U> const &other) : arena(other.arena) {}
+
+  T *allocate(size_t n) {
+    return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T *, size_t) {}
+
+  template <typename U> bool operator==(ArenaAllocator<U> const &other) const {
+    return arena == other.arena;
+  }
+  template <typename U> bool operator!=(ArenaAllocator<U> const &other) const {
+    return arena != other.arena;
+  }
+};
+
+#endif
@@ -0,0 +1,705 @@
+#include "cache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+#ifdef __linux__
+#include <link.h>
+#endif
+
+static constexpr char CACHE_MAGIC[4] = {'Q', 'B', 'I', 'R'};
+static constexpr char AST_CACHE_MAGIC[4] = {'Q', 'B', 'A', 'S'};
+
+#ifdef __linux__
+// looks up the gnu build id among the notes of the executable, which is
+// always the first object that is visited.
+static int find_build_id(dl_phdr_info *info, size_t, void *data) {
+  std::string_view &build_id = *static_cast<std::string_view *>(data);
+  for (size_t i = 0; i < info->dlpi_phnum; i++) {
+    ElfW(Phdr) const &phdr = info->dlpi_phdr[i];
+    if (phdr.p_type != PT_NOTE)
+      continue;
+    char const *note = (char const *)(info->dlpi_addr + phdr.p_vaddr);
+    char const *end = note + phdr.p_memsz;
+    while (note + sizeof(ElfW(Nhdr)) <= end) {
+      ElfW(Nhdr) const *header = (ElfW(Nhdr) const *)note;
+      char const *name = note + sizeof(ElfW(Nhdr));
+      char const *desc = name + ((header->n_namesz + 3) & ~3u);
+      if (header->n_type == NT_GNU_BUILD_ID && header->n_namesz == 4 &&
+          std::memcmp(name, "GNU", 4) == 0 && desc + header->n_descsz <= end) {
+        build_id = std::string_view(desc, header->n_descsz);
+        return 1;
+      }
+      note = desc + ((header->n_descsz + 3) & ~3u);
+    }
+  }
+  return 1;
+}
+#endif
+
+// identifies the binary that wrote a cache, since the layout of the IR can
+// change without CONFIG_CACHE_VERSION being bumped. this is the build id of
+// the executable if it has one, or the time this file was compiled.
+static uint64_t binary_identity() {
+  static uint64_t const identity = []() {
+    std::string_view id = __DATE__ " " __TIME__;
+#ifdef __linux__
+    dl_iterate_phdr(find_build_id, &id);
+#endif
+    return OSLayer::hash_content(id);
+  }();
+  return identity;
+}
+
+enum StringKind : uint8_t {
+  S_CONFIG, // view into a config file, stored as an offset.
+  S_INLINE, // stored in the cache itself.
+};
+
+// appends fixed-size integers and strings to the cache contents.
+// note: the cache is only ever read by the machine that wrote it, so
+// values are stored in native byte order.
+struct CacheWriter {
+  // config files, sorted by address so that strings can be located.
+  std::vector<std::pair<std::string_view, uint32_t>> sources;
+  std::string out;
+
+  CacheWriter(std::vector<std::string_view> const &configs) {
+    for (uint32_t i = 0; i < configs.size(); i++)
+      sources.push_back({configs[i], i});
+    std::sort(sources.begin(), sources.end(), [](auto const &a, auto const &b) {
+      return std::less<char const *>()(a.first.data(), b.first.data());
+    });
+  }
+
+  template <typename T> void integer(T value) {
+    static_assert(std::is_integral<T>::value || std::is_enum<T>::value);
+    out.append(reinterpret_cast<char const *>(&value), sizeof(T));
+  }
+
+  void string(std::string_view string) {
+    auto source = std::upper_bound(
+        sources.begin(), sources.end(), string.data(),
+        [](char const *data, auto const &source) {
+          return std::less<char const *>()(data, source.first.data());
+        });
+    if (!string.empty() && source != sources.begin()) {
+      std::string_view config = (--source)->first;
+      if (!std::less<char const *>()(config.data() + config.size(),
+                                     string.data() + string.size())) {
+        integer<uint8_t>(S_CONFIG);
+        integer<uint32_t>(source->second);
+        integer<uint64_t>(string.data() - config.data());
+        integer<uint64_t>(string.size());
+        return;
+      }
+    }
+    integer<uint8_t>(S_INLINE);
+    integer<uint64_t>(string.size());
+    out.append(string);
+  }
+
+  void origin(Origin const &handle) {
+    OriginInfo origin = handle.info();
+    integer<uint8_t>(origin.index());
+    if (std::holds_alternative<InputStreamPos>(origin)) {
+      integer<uint64_t>(std::get<InputStreamPos>(origin).index);
+      integer<uint64_t>(std::get<InputStreamPos>(origin).line);
+      integer<uint32_t>(std::get<InputStreamPos>(origin).file);
+    } else if (std::holds_alternative<ObjectReference>(origin)) {
+      string(std::get<ObjectReference>(origin));
+    }
+  }
+
+  void istring(IString const &istring) {
+    origin(istring.origin);
+    string(istring.content);
+  }
+
+  void ibool(IBool const &ibool) {
+    origin(ibool.origin);
+    integer<uint8_t>(ibool.content);
+  }
+
+  void value(IValue const &value) {
+    integer<uint8_t>(value.value.index());
+    integer<uint8_t>(value.immutable);
+    if (std::holds_alternative<IString>(value.value))
+      return istring(std::get<IString>(value.value));
+    if (std::holds_alternative<IBool>(value.value))
+      return ibool(std::get<IBool>(value.value));
+    IList const &list = std::get<IList>(value.value);
+    origin(list.origin);
+    integer<uint8_t>(list.contents->index());
+    integer<uint64_t>(list.size());
+    if (list.holds_qbstring())
+      for (IString const &element : list.strings())
+        istring(element);
+    else
+      for (IBool const &element : list.bools())
+        ibool(element);
+  }
+};
+
+// reads back what the writer produced. any out-of-bounds read marks the
+// cache as invalid, rather than throwing.
+struct CacheReader {
+  std::string_view in;
+  std::vector<std::string_view> sources;
+  std::optional<uint32_t> file; // overrides the file of every origin.
+  size_t offset = 0;
+  bool valid = true;
+
+  template <typename T> T integer() {
+    T value{};
+    if (in.size() - offset < sizeof(T)) {
+      valid = false;
+      return value;
+    }
+    std::memcpy(&value, in.data() + offset, sizeof(T));
+    offset += sizeof(T);
+    return value;
+  }
+
+  // element counts are bounded by the remaining input, so a corrupt cache
+  // can't cause a huge allocation.
+  size_t count() {
+    uint64_t count = integer<uint64_t>();
+    if (count > in.size() - offset) {
+      valid = false;
+      return 0;
+    }
+    return count;
+  }
+
+  std::string_view string() {
+    uint8_t kind = integer<uint8_t>();
+    if (kind == S_CONFIG) {
+      uint32_t source = integer<uint32_t>();
+      uint64_t begin = integer<uint64_t>();
+      uint64_t size = integer<uint64_t>();
+      if (source >= sources.size() || begin > sources[source].size() ||
+          size > sources[source].size() - begin) {
+        valid = false;
+        return {};
+      }
+      return sources[source].substr(begin, size);
+    }
+    uint64_t size = integer<uint64_t>();
+    if (kind != S_INLINE || size > in.size() - offset) {
+      valid = false;
+      return {};
+    }
+    offset += size;
+    return in.substr(offset - size, size);
+  }
+
+  Origin origin() {
+    switch (integer<uint8_t>()) {
+    case 0: {
+      size_t index = integer<uint64_t>();
+      size_t line = integer<uint64_t>();
+      uint32_t file = integer<uint32_t>();
+      if (this->file)
+        file = *this->file;
+      else if (file >= sources.size())
+        valid = false;
+      return InputStreamPos{index, line, file};
+    }
+    case 1:
+      return ObjectReference(string());
+    case 2:
+      return InternalNode{};
+    }
+    valid = false;
+    return InternalNode{};
+  }
+
+  IString istring() {
+    Origin origin = this->origin();
+    return IString(string(), origin);
+  }
+
+  IBool ibool() {
+    Origin origin = this->origin();
+    return IBool(integer<uint8_t>() != 0, origin);
+  }
+
+  IValue value() {
+    uint8_t type = integer<uint8_t>();
+    bool immutable = integer<uint8_t>() != 0;
+    if (type == 0)
+      return {istring(), immutable};
+    if (type == 1)
+      return {ibool(), immutable};
+    Origin origin = this->origin();
+    uint8_t contents_type = integer<uint8_t>();
+    size_t size = count();
+    IListContents contents;
+    if (contents_type == QBLIST_STR) {
+      IStringList strings;
+      strings.reserve(size);
+      for (size_t i = 0; i < size && valid; i++)
+        strings.push_back(istring());
+      contents = std::move(strings);
+    } else {
+      IBoolList bools;
+      bools.reserve(size);
+      for (size_t i = 0; i < size && valid; i++)
+        bools.push_back(ibool());
+      contents = std::move(bools);
+    }
+    if (type != 2 || contents_type > QBLIST_BOOL)
+      valid = false;
+    return {IList(std::move(contents), origin), immutable};
+  }
+};
+
+// simulates the stack of an expression, which has to leave exactly one
+// value behind without ever popping more values than were pushed.
+static bool validate_stack(IRProgram const &program,
+                           IRExpression const &expression) {
+  size_t depth = 0;
+  for (uint32_t pc = expression.begin; pc < expression.end; pc++) {
+    IRInstruction const &instruction = program.code[pc];
+    switch (instruction.opcode) {
+    case IROpCode::Constant:
+    case IROpCode::Load:
+      depth++;
+      break;
+    case IROpCode::Interpolate:
+    case IROpCode::MakeList:
+      if (instruction.count > depth)
+        return false;
+      depth = depth - instruction.count + 1;
+      break;
+    case IROpCode::Glob:
+    case IROpCode::Replace:
+      if (depth < 1)
+        return false;
+      break;
+    case IROpCode::ReplaceDynamic:
+      if (depth < 3)
+        return false;
+      depth -= 2;
+      break;
+    }
+  }
+  return depth == 1;
+}
+
+// checks that every index in the program is in bounds, and that every
+// expression is well-formed, so that a corrupt cache is never evaluated.
+static bool validate(IRProgram const &program) {
+  for (IRInstruction const &instruction : program.code) {
+    if (instruction.opcode > IROpCode::ReplaceDynamic ||
+        instruction.type > IRType::Unknown)
+      return false;
+    if (instruction.opcode == IROpCode::Constant &&
+        instruction.operand >= program.constants.size())
+      return false;
+    if (instruction.opcode == IROpCode::Load &&
+        instruction.operand >= program.references.size())
+      return false;
+    if (instruction.opcode == IROpCode::Replace &&
+        instruction.operand >= program.patterns.size())
+      return false;
+  }
+  for (IRReference const &reference : program.references)
+    if (reference.kind > IRReferenceKind::Unresolved ||
+        (reference.kind == IRReferenceKind::Field &&
+         reference.field >= program.fields.size()))
+      return false;
+  for (IRExpression const &expression : program.expressions)
+    if (expression.begin > expression.end ||
+        expression.end > program.code.size() ||
+        !validate_stack(program, expression))
+      return false;
+  for (IRField const &field : program.fields)
+    if (field.id >= program.fields.size() ||
+        field.expression >= program.expressions.size())
+      return false;
+  for (IRTask const &task : program.tasks)
+    if (task.identifier >= program.expressions.size() ||
+        task.fields_begin > task.fields_end ||
+        task.fields_end > program.fields.size())
+      return false;
+  return program.global_fields <= program.fields.size() &&
+         program.origins.size() == program.code.size();
+}
+
+// reads the program itself, see `ConfigCache::store`.
+static std::optional<IRProgram> read_program(CacheReader &reader) {
+  IRProgram program;
+  program.code.resize(reader.count());
+  for (IRInstruction &instruction : program.code) {
+    instruction.opcode = reader.integer<IROpCode>();
+    instruction.type = reader.integer<IRType>();
+    instruction.no_glob = reader.integer<uint8_t>() != 0;
+    instruction.operand = reader.integer<uint32_t>();
+    instruction.count = reader.integer<uint32_t>();
+  }
+  size_t origins = reader.count();
+  program.origins.reserve(origins);
+  for (size_t i = 0; i < origins && reader.valid; i++)
+    program.origins.push_back(reader.origin());
+  size_t constants = reader.count();
+  program.constants.reserve(constants);
+  for (size_t i = 0; i < constants && reader.valid; i++)
+    program.constants.push_back(reader.value());
+  program.references.resize(reader.count());
+  for (IRReference &reference : program.references) {
+    reference.kind = reader.integer<IRReferenceKind>();
+    reference.field = reader.integer<uint32_t>();
+    reference.name = reader.string();
+  }
+  program.patterns.resize(reader.count());
+  for (IRPattern &pattern : program.patterns) {
+    pattern.original.resize(reader.count());
+    for (std::string_view &chunk : pattern.original)
+      chunk = reader.string();
+    pattern.replacement.resize(reader.count());
+    for (std::string_view &chunk : pattern.replacement)
+      chunk = reader.string();
+    pattern.replacement_size = reader.integer<uint64_t>();
+  }
+  program.expressions.resize(reader.count());
+  for (IRExpression &expression : program.expressions) {
+    expression.begin = reader.integer<uint32_t>();
+    expression.end = reader.integer<uint32_t>();
+    expression.type = reader.integer<IRType>();
+  }
+  program.fields.resize(reader.count());
+  for (IRField &field : program.fields) {
+    field.name = reader.string();
+    field.id = reader.integer<uint32_t>();
+    field.expression = reader.integer<uint32_t>();
+    field.global = reader.integer<uint8_t>() != 0;
+    field.origin = reader.origin();
+  }
+  program.tasks.resize(reader.count());
+  for (IRTask &task : program.tasks) {
+    task.identifier = reader.integer<uint32_t>();
+    task.iterator = reader.string();
+    task.fields_begin = reader.integer<uint32_t>();
+    task.fields_end = reader.integer<uint32_t>();
+    task.origin = reader.origin();
+  }
+  program.global_fields = reader.integer<uint32_t>();
+
+  if (!reader.valid || reader.offset != reader.in.size() ||
+      !validate(program))
+    return std::nullopt;
+  return program;
+}
+
+// checks the magic, version and binary identity of a cache.
+static bool read_header(CacheReader &reader, char const (&magic)[4]) {
+  char header[4];
+  for (char &c : header)
+    c = reader.integer<char>();
+  return reader.valid && std::memcmp(header, magic, 4) == 0 &&
+         reader.integer<uint32_t>() == CONFIG_CACHE_VERSION &&
+         reader.integer<uint64_t>() == binary_identity() && reader.valid;
+}
+
+static void write_header(CacheWriter &writer, char const (&magic)[4]) {
+  writer.out.append(magic, 4);
+  writer.integer<uint32_t>(CONFIG_CACHE_VERSION);
+  writer.integer<uint64_t>(binary_identity());
+}
+
+// returns the program stored in the cache, if it was compiled from the
+// exact same config files. imported files are loaded as they're checked.
+std::optional<IRProgram> ConfigCache::load(InputBuffer const &cache,
+                                           std::vector<ConfigSource> &sources) {
+  CacheReader reader = {cache.view(), {}, std::nullopt};
+  if (!read_header(reader, CACHE_MAGIC))
+    return std::nullopt;
+
+  size_t files = reader.count();
+  for (size_t i = 0; i < files && reader.valid; i++) {
+    std::string path(reader.string());
+    uint64_t hash = reader.integer<uint64_t>();
+    uint64_t size = reader.integer<uint64_t>();
+    if (i > 0) {
+      std::optional<InputBuffer> buffer = InputBuffer::map_file(path);
+      if (!buffer) {
+        reader.valid = false;
+        break;
+      }
+      sources.push_back({path, std::move(*buffer), std::nullopt});
+    }
+    std::string_view config = sources[i].buffer.view();
+    reader.sources.push_back(config);
+    if (config.size() != size || OSLayer::hash_content(config) != hash)
+      reader.valid = false;
+  }
+
+  std::optional<IRProgram> program;
+  if (files > 0 && reader.valid)
+    program = read_program(reader);
+  if (!program)
+    sources.erase(sources.begin() + 1, sources.end());
+  return program;
+}
+
+// serializes the program. strings that point into a config file are stored
+// as offsets, everything else (e.g. folded literals) is stored inline.
+bool ConfigCache::store(IRProgram const &program,
+                        std::vector<ConfigSource> const &sources,
+                        std::string const &path) {
+  std::vector<std::string_view> configs;
+  for (ConfigSource const &source : sources)
+    configs.push_back(source.buffer.view());
+  CacheWriter writer(configs);
+  write_header(writer, CACHE_MAGIC);
+  writer.integer<uint64_t>(sources.size());
+  for (ConfigSource const &source : sources) {
+    writer.string(source.path);
+    writer.integer<uint64_t>(OSLayer::hash_content(source.buffer.view()));
+    writer.integer<uint64_t>(source.buffer.view().size());
+  }
+
+  writer.integer<uint64_t>(program.code.size());
+  for (IRInstruction const &instruction : program.code) {
+    writer.integer(instruction.opcode);
+    writer.integer(instruction.type);
+    writer.integer<uint8_t>(instruction.no_glob);
+    writer.integer(instruction.operand);
+    writer.integer(instruction.count);
+  }
+  writer.integer<uint64_t>(program.origins.size());
+  for (Origin const &origin : program.origins)
+    writer.origin(origin);
+  writer.integer<uint64_t>(program.constants.size());
+  for (IValue const &value : program.constants)
+    writer.value(value);
+  writer.integer<uint64_t>(program.references.size());
+  for (IRReference const &reference : program.references) {
+    writer.integer(reference.kind);
+    writer.integer(reference.field);
+    writer.string(reference.name);
+  }
+  writer.integer<uint64_t>(program.patterns.size());
+  for (IRPattern const &pattern : program.patterns) {
+    writer.integer<uint64_t>(pattern.original.size());
+    for (std::string_view chunk : pattern.original)
+      writer.string(chunk);
+    writer.integer<uint64_t>(pattern.replacement.size());
+    for (std::string_view chunk : pattern.replacement)
+      writer.string(chunk);
+    writer.integer<uint64_t>(pattern.replacement_size);
+  }
+  writer.integer<uint64_t>(program.expressions.size());
+  for (IRExpression const &expression : program.expressions) {
+    writer.integer(expression.begin);
+    writer.integer(expression.end);
+    writer.integer(expression.type);
+  }
+  writer.integer<uint64_t>(program.fields.size());
+  for (IRField const &field : program.fields) {
+    writer.string(field.name);
+    writer.integer(field.id);
+    writer.integer(field.expression);
+    writer.integer<uint8_t>(field.global);
+    writer.origin(field.origin);
+  }
+  writer.integer<uint64_t>(program.tasks.size());
+  for (IRTask const &task : program.tasks) {
+    writer.integer(task.identifier);
+    writer.string(task.iterator);
+    writer.integer(task.fields_begin);
+    writer.integer(task.fields_end);
+    writer.origin(task.origin);
+  }
+  writer.integer(program.global_fields);
+
+  return OSLayer::write_file_atomic(path, writer.out);
+}
+
+// checks that every node id in the AST is in bounds.
+static bool validate(AST const &ast) {
+  auto in_range = [&](uint32_t begin, uint32_t size) {
+    return begin <= ast.children.size() && size <= ast.children.size() - begin;
+  };
+  for (ASTObject const &node : ast.nodes) {
+    if (std::holds_alternative<FormattedLiteral>(node) &&
+        !in_range(std::get<FormattedLiteral>(node).contents_begin,
+                  std::get<FormattedLiteral>(node).contents_size))
+      return false;
+    if (std::holds_alternative<List>(node) &&
+        !in_range(std::get<List>(node).contents_begin,
+                  std::get<List>(node).contents_size))
+      return false;
+    if (std::holds_alternative<Replace>(node)) {
+      Replace const &replace = std::get<Replace>(node);
+      if (replace.identifier >= ast.nodes.size() ||
+          replace.original >= ast.nodes.size() ||
+          replace.replacement >= ast.nodes.size())
+        return false;
+    }
+  }
+  for (ASTNodeId child : ast.children)
+    if (child >= ast.nodes.size())
+      return false;
+  for (Field const &field : ast.fields)
+    if (field.expression >= ast.nodes.size())
+      return false;
+  for (Task const &task : ast.tasks) {
+    if (task.identifier >= ast.nodes.size())
+      return false;
+    for (Field const &field : task.fields)
+      if (field.expression >= ast.nodes.size())
+        return false;
+  }
+  return true;
+}
+
+static Field read_field(CacheReader &reader) {
+  Field field;
+  field.identifier.content = reader.string();
+  field.identifier.origin = reader.origin();
+  field.expression = reader.integer<uint32_t>();
+  field.origin = reader.origin();
+  return field;
+}
+
+static void write_field(CacheWriter &writer, Field const &field) {
+  writer.string(field.identifier.content);
+  writer.origin(field.identifier.origin);
+  writer.integer(field.expression);
+  writer.origin(field.origin);
+}
+
+// returns the AST of a single file, if it was parsed from the exact same
+// contents. origins are moved to the given file.
+std::optional<AST> ConfigCache::load_ast(InputBuffer const &cache,
+                                         std::string_view config,
+                                         uint32_t file) {
+  CacheReader reader = {cache.view(), {config}, file};
+  if (!read_header(reader, AST_CACHE_MAGIC) ||
+      reader.integer<uint64_t>() != OSLayer::hash_content(config) ||
+      reader.integer<uint64_t>() != config.size())
+    return std::nullopt;
+
+  AST ast;
+  size_t nodes = reader.count();
+  ast.nodes.reserve(nodes);
+  for (size_t i = 0; i < nodes && reader.valid; i++) {
+    uint8_t type = reader.integer<uint8_t>();
+    if (type == 0) {
+      std::string_view content = reader.string();
+      ast.nodes.push_back(Identifier{content, reader.origin()});
+    } else if (type == 1) {
+      std::string_view content = reader.string();
+      ast.nodes.push_back(Literal{content, reader.origin()});
+    } else if (type == 2 || type == 3) {
+      uint32_t begin = reader.integer<uint32_t>();
+      uint32_t size = reader.integer<uint32_t>();
+      if (type == 2)
+        ast.nodes.push_back(FormattedLiteral{begin, size, reader.origin()});
+      else
+        ast.nodes.push_back(List{begin, size, reader.origin()});
+    } else if (type == 4) {
+      bool content = reader.integer<uint8_t>() != 0;
+      ast.nodes.push_back(Boolean{content, reader.origin()});
+    } else if (type == 5) {
+      ASTNodeId identifier = reader.integer<uint32_t>();
+      ASTNodeId original = reader.integer<uint32_t>();
+      ASTNodeId replacement = reader.integer<uint32_t>();
+      ast.nodes.push_back(
+          Replace{identifier, original, replacement, reader.origin()});
+    } else {
+      reader.valid = false;
+    }
+  }
+  ast.children.resize(reader.count());
+  for (ASTNodeId &child : ast.children)
+    child = reader.integer<uint32_t>();
+  ast.fields.resize(reader.count());
+  for (Field &field : ast.fields)
+    field = read_field(reader);
+  ast.tasks.resize(reader.count());
+  for (Task &task : ast.tasks) {
+    task.identifier = reader.integer<uint32_t>();
+    task.iterator.content = reader.string();
+    task.iterator.origin = reader.origin();
+    task.fields.resize(reader.count());
+    for (Field &field : task.fields)
+      field = read_field(reader);
+    task.origin = reader.origin();
+  }
+  ast.imports.resize(reader.count());
+  for (Import &import : ast.imports) {
+    import.path = reader.string();
+    import.origin = reader.origin();
+  }
+
+  if (!reader.valid || reader.offset != reader.in.size() || !validate(ast))
+    return std::nullopt;
+  return ast;
+}
+
+bool ConfigCache::store_ast(AST const &ast, std::string_view config,
+                            std::string const &path) {
+  CacheWriter writer({config});
+  write_header(writer, AST_CACHE_MAGIC);
+  writer.integer<uint64_t>(OSLayer::hash_content(config));
+  writer.integer<uint64_t>(config.size());
+
+  writer.integer<uint64_t>(ast.nodes.size());
+  for (ASTObject const &node : ast.nodes) {
+    writer.integer<uint8_t>(node.index());
+    if (std::holds_alternative<Identifier>(node)) {
+      writer.string(std::get<Identifier>(node).content);
+      writer.origin(std::get<Identifier>(node).origin);
+    } else if (std::holds_alternative<Literal>(node)) {
+      writer.string(std::get<Literal>(node).content);
+      writer.origin(std::get<Literal>(node).origin);
+    } else if (std::holds_alternative<FormattedLiteral>(node)) {
+      FormattedLiteral const &formatted_literal =
+          std::get<FormattedLiteral>(node);
+      writer.integer(formatted_literal.contents_begin);
+      writer.integer(formatted_literal.contents_size);
+      writer.origin(formatted_literal.origin);
+    } else if (std::holds_alternative<List>(node)) {
+      writer.integer(std::get<List>(node).contents_begin);
+      writer.integer(std::get<List>(node).contents_size);
+      writer.origin(std::get<List>(node).origin);
+    } else if (std::holds_alternative<Boolean>(node)) {
+      writer.integer<uint8_t>(std::get<Boolean>(node).content);
+      writer.origin(std::get<Boolean>(node).origin);
+    } else {
+      Replace const &replace = std::get<Replace>(node);
+      writer.integer(replace.identifier);
+      writer.integer(replace.original);
+      writer.integer(replace.replacement);
+      writer.origin(replace.origin);
+    }
+  }
+  writer.integer<uint64_t>(ast.children.size());
+  for (ASTNodeId child : ast.children)
+    writer.integer(child);
+  writer.integer<uint64_t>(ast.fields.size());
+  for (Field const &field : ast.fields)
+    write_field(writer, field);
+  writer.integer<uint64_t>(ast.tasks.size());
+  for (Task const &task : ast.tasks) {
+    writer.integer(task.identifier);
+    writer.string(task.iterator.content);
+    writer.origin(task.iterator.origin);
+    writer.integer<uint64_t>(task.fields.size());
+    for (Field const &field : task.fields)
+      write_field(writer, field);
+    writer.origin(task.origin);
+  }
+  writer.integer<uint64_t>(ast.imports.size());
+  for (Import const &import : ast.imports) {
+    writer.string(import.path);
+    writer.origin(import.origin);
+  }
+
+  return OSLayer::write_file_atomic(path, writer.out);
+}
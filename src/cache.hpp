@@ -0,0 +1,39 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "compiler.hpp"
+#include "loader.hpp"
+#include "oslayer.hpp"
+#include "parser.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#define CONFIG_CACHE_FILE "./.quickbuild.bin"
+// bump whenever the layout of the IR (or of the cache itself) changes. caches
+// are also only read by the binary that wrote them.
+#define CONFIG_CACHE_VERSION 3
+
+// compiled programs are cached on disk, keyed by a hash of every config file
+// they were compiled from. the ASTs of single files are cached the same way,
+// so that only modified files have to be parsed again. strings are either
+// views into the config files or into the mapped cache, so both have to
+// outlive the program.
+class ConfigCache {
+public:
+  // note: the root config has to be loaded already, and imported files are
+  // appended to the sources.
+  static std::optional<IRProgram> load(InputBuffer const &cache,
+                                       std::vector<ConfigSource> &sources);
+  static bool store(IRProgram const &program,
+                    std::vector<ConfigSource> const &sources,
+                    std::string const &path);
+  static std::optional<AST> load_ast(InputBuffer const &cache,
+                                     std::string_view config, uint32_t file);
+  static bool store_ast(AST const &ast, std::string_view config,
+                        std::string const &path);
+};
+
+#endif
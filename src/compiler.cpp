@@ -0,0 +1,335 @@
+#include "compiler.hpp"
+
+// splits both sides of a replacement on their wildcards. note that a
+// trailing wildcard doesn't produce an empty chunk.
+IRPattern IRPattern::split(std::string_view original,
+                           std::string_view replacement) {
+  auto split_chunks = [](std::string_view pattern) {
+    std::vector<std::string_view> chunks;
+    size_t start = 0;
+    while (start < pattern.size()) {
+      size_t end = pattern.find('*', start);
+      if (end == std::string_view::npos)
+        end = pattern.size();
+      chunks.push_back(pattern.substr(start, end - start));
+      start = end + 1;
+    }
+    return chunks;
+  };
+  IRPattern pattern = {split_chunks(original), split_chunks(replacement), 0};
+  for (size_t i = 0;
+       i < pattern.original.size() && i < pattern.replacement.size(); i++)
+    pattern.replacement_size += pattern.replacement[i].size();
+  return pattern;
+}
+
+IRField const *IRProgram::find_field(std::string_view name,
+                                     IRTask const *task) const {
+  // task-specific fields.
+  if (task)
+    for (uint32_t i = task->fields_begin; i < task->fields_end; i++)
+      if (fields[i].name == name)
+        return &fields[i];
+
+  // global fields.
+  for (uint32_t i = 0; i < global_fields; i++)
+    if (fields[i].name == name)
+      return &fields[i];
+  return nullptr;
+}
+
+Compiler::Compiler(AST const &ast, Arena &arena)
+    : m_ast(ast), m_arena(arena) {
+  m_scope = nullptr;
+  m_no_glob = false;
+}
+
+uint32_t Compiler::emit(IROpCode opcode, IRType type, uint32_t operand,
+                        uint32_t count, Origin origin) {
+  m_program.code.push_back({opcode, type, m_no_glob, operand, count});
+  m_program.origins.push_back(origin);
+  return m_program.code.size() - 1;
+}
+
+Compiler::Node Compiler::push_constant(IValue value, Origin origin) {
+  IRType type = IRType::Unknown;
+  if (std::holds_alternative<IString>(value.value))
+    type = IRType::String;
+  else if (std::holds_alternative<IBool>(value.value))
+    type = IRType::Bool;
+  else if (std::get<IList>(value.value).holds_qbstring())
+    type = IRType::StringList;
+  else
+    type = IRType::BoolList;
+  m_program.constants.push_back(std::move(value));
+  uint32_t constant = m_program.constants.size() - 1;
+  uint32_t begin = emit(IROpCode::Constant, type, constant, 0, origin);
+  return {begin, type, constant};
+}
+
+// compiles the AST into a program.
+IRProgram Compiler::compile() {
+  // every field needs an id before any references can be resolved.
+  for (Field const &field : m_ast.fields)
+    m_program.fields.push_back({field.identifier.content,
+                                (uint32_t)m_program.fields.size(), 0, true,
+                                field.origin});
+  m_program.global_fields = m_program.fields.size();
+  m_globals.reserve(m_program.global_fields);
+  for (IRField const &field : m_program.fields)
+    m_globals.emplace(field.name, field.id);
+  for (Task const &task : m_ast.tasks) {
+    IRTask ir_task;
+    ir_task.iterator = task.iterator.content;
+    ir_task.origin = task.origin;
+    ir_task.fields_begin = m_program.fields.size();
+    for (Field const &field : task.fields)
+      m_program.fields.push_back({field.identifier.content,
+                                  (uint32_t)m_program.fields.size(), 0, false,
+                                  field.origin});
+    ir_task.fields_end = m_program.fields.size();
+    m_program.tasks.push_back(ir_task);
+  }
+
+  // global fields and task identifiers are evaluated in the global scope.
+  for (size_t i = 0; i < m_ast.fields.size(); i++)
+    m_program.fields[i].expression =
+        compile_expression(m_ast.fields[i].expression);
+  for (size_t i = 0; i < m_ast.tasks.size(); i++)
+    m_program.tasks[i].identifier =
+        compile_expression(m_ast.tasks[i].identifier);
+
+  // task fields are evaluated in the scope of their task.
+  for (size_t i = 0; i < m_ast.tasks.size(); i++) {
+    m_scope = &m_program.tasks[i];
+    for (size_t j = 0; j < m_ast.tasks[i].fields.size(); j++)
+      m_program.fields[m_scope->fields_begin + j].expression =
+          compile_expression(m_ast.tasks[i].fields[j].expression);
+  }
+  m_scope = nullptr;
+
+  return std::move(m_program);
+}
+
+uint32_t Compiler::compile_expression(ASTNodeId id) {
+  uint32_t begin = m_program.code.size();
+  Node node = compile_node(id);
+  m_program.expressions.push_back(
+      {begin, (uint32_t)m_program.code.size(), node.type});
+  return m_program.expressions.size() - 1;
+}
+
+Compiler::Node Compiler::compile_node(ASTNodeId id) {
+  ASTObject const &ast_object = m_ast[id];
+  if (std::holds_alternative<Identifier>(ast_object))
+    return compile_identifier(std::get<Identifier>(ast_object));
+  if (std::holds_alternative<Literal>(ast_object)) {
+    // note: bare literals are never globbed.
+    Literal const &literal = std::get<Literal>(ast_object);
+    return push_constant({IString(literal.content, literal.origin)},
+                         literal.origin);
+  }
+  if (std::holds_alternative<FormattedLiteral>(ast_object))
+    return compile_formatted_literal(std::get<FormattedLiteral>(ast_object));
+  if (std::holds_alternative<List>(ast_object))
+    return compile_list(std::get<List>(ast_object));
+  if (std::holds_alternative<Boolean>(ast_object)) {
+    Boolean const &boolean = std::get<Boolean>(ast_object);
+    return push_constant({IBool(boolean.content, boolean.origin)},
+                         boolean.origin);
+  }
+  return compile_replace(std::get<Replace>(ast_object));
+}
+
+// identifiers are resolved statically: task-specific fields take
+// precedence over the iteration variable, which takes precedence over
+// global fields.
+uint32_t Compiler::resolve(Identifier const &identifier) {
+  IRReference reference = {IRReferenceKind::Unresolved, 0,
+                           identifier.content};
+  IRField const *field = nullptr;
+  for (uint32_t i = m_scope ? m_scope->fields_begin : 0;
+       m_scope && i < m_scope->fields_end && !field; i++)
+    if (m_program.fields[i].name == identifier.content)
+      field = &m_program.fields[i];
+  auto global = m_globals.find(identifier.content);
+  if (!field && global != m_globals.end())
+    field = &m_program.fields[global->second];
+  if (field && !field->global)
+    reference = {IRReferenceKind::Field, field->id, identifier.content};
+  else if (m_scope && m_scope->iterator == identifier.content)
+    reference = {IRReferenceKind::Iterator, 0, identifier.content};
+  else if (field)
+    reference = {IRReferenceKind::Field, field->id, identifier.content};
+  m_program.references.push_back(reference);
+  return m_program.references.size() - 1;
+}
+
+Compiler::Node Compiler::compile_identifier(Identifier const &identifier) {
+  uint32_t begin = emit(IROpCode::Load, IRType::Unknown, resolve(identifier),
+                        0, identifier.origin);
+  return {begin, IRType::Unknown, std::nullopt};
+}
+
+// formatted literals without any escaped expressions are folded into a
+// constant, unless they need to be globbed.
+Compiler::Node
+Compiler::compile_formatted_literal(FormattedLiteral const &formatted_literal) {
+  uint32_t begin = m_program.code.size();
+  ASTNodeId const *contents =
+      m_ast.children.data() + formatted_literal.contents_begin;
+  uint32_t size = formatted_literal.contents_size;
+  bool pure = true;
+  for (uint32_t i = 0; i < size; i++)
+    pure &= std::holds_alternative<Literal>(m_ast[contents[i]]);
+
+  if (pure) {
+    std::string_view content;
+    if (size == 1)
+      content = std::get<Literal>(m_ast[contents[0]]).content;
+    else {
+      std::string joined;
+      for (uint32_t i = 0; i < size; i++)
+        joined += std::get<Literal>(m_ast[contents[i]]).content;
+      content = m_arena.copy_string(joined);
+    }
+    Node node = push_constant({IString(content, formatted_literal.origin)},
+                              formatted_literal.origin);
+    if (m_no_glob || content.find('*') == std::string_view::npos)
+      return node;
+    emit(IROpCode::Glob, IRType::Unknown, 0, 0, formatted_literal.origin);
+    return {begin, IRType::Unknown, std::nullopt};
+  }
+
+  // empty literals don't contribute to the result.
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < size; i++) {
+    ASTObject const &ast_obj = m_ast[contents[i]];
+    if (std::holds_alternative<Literal>(ast_obj) &&
+        std::get<Literal>(ast_obj).content.empty())
+      continue;
+    compile_node(contents[i]);
+    count++;
+  }
+  emit(IROpCode::Interpolate, IRType::String, 0, count,
+       formatted_literal.origin);
+  if (m_no_glob)
+    return {begin, IRType::String, std::nullopt};
+  emit(IROpCode::Glob, IRType::Unknown, 0, 0, formatted_literal.origin);
+  return {begin, IRType::Unknown, std::nullopt};
+}
+
+// lists are flattened, and folded into a constant if every element is one.
+Compiler::Node Compiler::compile_list(List const &list) {
+  uint32_t begin = m_program.code.size();
+  uint32_t constants_begin = m_program.constants.size();
+
+  // nested lists (e.g. `[a, b], c`) are flattened on evaluation anyway.
+  std::vector<ASTNodeId> elements;
+  std::vector<ASTNodeId> pending;
+  for (uint32_t i = list.contents_size; i > 0; i--)
+    pending.push_back(m_ast.children[list.contents_begin + i - 1]);
+  while (!pending.empty()) {
+    ASTNodeId id = pending.back();
+    pending.pop_back();
+    if (std::holds_alternative<List>(m_ast[id])) {
+      List const &inner = std::get<List>(m_ast[id]);
+      for (uint32_t i = inner.contents_size; i > 0; i--)
+        pending.push_back(m_ast.children[inner.contents_begin + i - 1]);
+      continue;
+    }
+    elements.push_back(id);
+  }
+
+  std::vector<Node> nodes;
+  nodes.reserve(elements.size());
+  for (ASTNodeId id : elements)
+    nodes.push_back(compile_node(id));
+
+  // infer the type of the list, if every element is known.
+  IRType type = IRType::Unknown;
+  bool consistent = true;
+  bool folded = true;
+  for (Node const &node : nodes) {
+    IRType element_type = node.type;
+    if (element_type == IRType::String)
+      element_type = IRType::StringList;
+    else if (element_type == IRType::Bool)
+      element_type = IRType::BoolList;
+    if (&node == &nodes.front())
+      type = element_type;
+    else if (type != element_type)
+      consistent = false;
+    folded &= node.constant.has_value();
+  }
+  if (!consistent)
+    type = IRType::Unknown;
+
+  // type mismatches are reported on evaluation, so they aren't folded.
+  if (!folded || type == IRType::Unknown) {
+    emit(IROpCode::MakeList, type, 0, nodes.size(), list.origin);
+    return {begin, type, std::nullopt};
+  }
+
+  IListContents contents;
+  if (type == IRType::StringList) {
+    IStringList strings;
+    for (Node const &node : nodes) {
+      IValue const &value = m_program.constants[*node.constant];
+      if (std::holds_alternative<IString>(value.value))
+        strings.push_back(std::get<IString>(value.value));
+      else
+        strings.append(std::get<IList>(value.value).strings());
+    }
+    contents = std::move(strings);
+  } else {
+    IBoolList bools;
+    for (Node const &node : nodes) {
+      IValue const &value = m_program.constants[*node.constant];
+      if (std::holds_alternative<IBool>(value.value))
+        bools.push_back(std::get<IBool>(value.value));
+      else
+        bools.append(std::get<IList>(value.value).bools());
+    }
+    contents = std::move(bools);
+  }
+
+  // discard the elements, they've been folded into a single constant.
+  m_program.code.resize(begin);
+  m_program.origins.resize(begin);
+  m_program.constants.resize(constants_begin);
+  return push_constant({IList(std::move(contents), list.origin)},
+                       list.origin);
+}
+
+// replacement patterns that are known ahead of time are split into their
+// chunks once, rather than on every evaluation.
+Compiler::Node Compiler::compile_replace(Replace const &replace) {
+  uint32_t begin = m_program.code.size();
+  bool no_glob = m_no_glob;
+  m_no_glob = true;
+  compile_node(replace.identifier);
+  uint32_t operands = m_program.code.size();
+  uint32_t constants_begin = m_program.constants.size();
+  Node original = compile_node(replace.original);
+  Node replacement = compile_node(replace.replacement);
+
+  if (original.constant && replacement.constant &&
+      original.type == IRType::String && replacement.type == IRType::String) {
+    IString const &original_str =
+        std::get<IString>(m_program.constants[*original.constant].value);
+    IString const &replacement_str =
+        std::get<IString>(m_program.constants[*replacement.constant].value);
+    m_program.patterns.push_back(
+        IRPattern::split(original_str.content, replacement_str.content));
+    m_program.code.resize(operands);
+    m_program.origins.resize(operands);
+    m_program.constants.resize(constants_begin);
+    emit(IROpCode::Replace, IRType::StringList,
+         m_program.patterns.size() - 1, 0, replace.origin);
+  } else {
+    emit(IROpCode::ReplaceDynamic, IRType::StringList, 0, 0, replace.origin);
+  }
+  m_no_glob = no_glob;
+  return {begin, IRType::StringList, std::nullopt};
+}
@@ -0,0 +1,137 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "arena.hpp"
+#include "parser.hpp"
+#include "values.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// statically inferred type of an expression, if it can be determined.
+enum class IRType : uint8_t {
+  String,
+  Bool,
+  StringList,
+  BoolList,
+  Unknown, // e.g. identifiers or anything that might be globbed.
+};
+
+enum class IROpCode : uint8_t {
+  Constant,    // push constants[operand].
+  Load,        // push the value of references[operand].
+  Interpolate, // pop `count` values and join them into one string.
+  Glob,        // expand the wildcards of the string on top of the stack.
+  MakeList,    // pop `count` values and flatten them into one list.
+  Replace,     // pop the input and apply patterns[operand] to it.
+  ReplaceDynamic, // pop the input, original and replacement and apply them.
+};
+
+// note: origins are kept in a separate table, indexed the same way.
+struct IRInstruction {
+  IROpCode opcode;
+  IRType type;     // type of the value pushed by this instruction.
+  bool no_glob;    // set inside of replacement operators.
+  uint32_t operand;
+  uint32_t count;
+};
+
+enum class IRReferenceKind : uint8_t {
+  Field,      // a task-specific or global field.
+  Iterator,   // the iteration variable of the task.
+  Unresolved, // reported as an error once (and if) it's evaluated.
+};
+
+struct IRReference {
+  IRReferenceKind kind;
+  uint32_t field; // only valid for fields.
+  std::string_view name;
+};
+
+// a replacement pattern, split into its chunks ahead of time.
+struct IRPattern {
+  std::vector<std::string_view> original;
+  std::vector<std::string_view> replacement;
+  size_t replacement_size; // total length of the replacement chunks used.
+  static IRPattern split(std::string_view original,
+                         std::string_view replacement);
+};
+
+// a contiguous range of instructions that evaluates to a single value.
+struct IRExpression {
+  uint32_t begin;
+  uint32_t end;
+  IRType type;
+};
+
+struct IRField {
+  std::string_view name;
+  uint32_t id;         // index in IRProgram::fields.
+  uint32_t expression; // index in IRProgram::expressions.
+  bool global;
+  Origin origin;
+};
+
+struct IRTask {
+  uint32_t identifier; // expression, evaluated in the global scope.
+  std::string_view iterator;
+  uint32_t fields_begin; // range of task-specific fields.
+  uint32_t fields_end;
+  Origin origin;
+};
+
+struct IRProgram {
+  std::vector<IRInstruction> code;
+  std::vector<Origin> origins;
+  std::vector<IValue> constants;
+  std::vector<IRReference> references;
+  std::vector<IRPattern> patterns;
+  std::vector<IRExpression> expressions;
+  std::vector<IRField> fields; // global fields first, then task fields.
+  std::vector<IRTask> tasks;
+  uint32_t global_fields;
+
+  IRField const *find_field(std::string_view name,
+                            IRTask const *task) const;
+};
+
+// lowers the AST into a flat program that the interpreter can evaluate
+// without walking the tree.
+class Compiler {
+private:
+  AST const &m_ast;
+  Arena &m_arena; // folded strings are stored alongside the AST.
+  IRProgram m_program;
+
+  IRTask const *m_scope; // task currently being compiled, if any.
+  bool m_no_glob;        // inside of a replacement operator.
+  // global fields by name, the first declaration takes precedence.
+  std::unordered_map<std::string_view, uint32_t> m_globals;
+
+  // helpers for compiling a single expression.
+  struct Node {
+    uint32_t begin;
+    IRType type;
+    std::optional<uint32_t> constant; // set if the node was folded.
+  };
+  Node compile_node(ASTNodeId id);
+  Node compile_identifier(Identifier const &identifier);
+  Node compile_formatted_literal(FormattedLiteral const &formatted_literal);
+  Node compile_list(List const &list);
+  Node compile_replace(Replace const &replace);
+  Node push_constant(IValue value, Origin origin);
+  uint32_t emit(IROpCode opcode, IRType type, uint32_t operand,
+                uint32_t count, Origin origin);
+  uint32_t compile_expression(ASTNodeId id);
+  uint32_t resolve(Identifier const &identifier);
+
+public:
+  Compiler(AST const &ast, Arena &arena);
+  IRProgram compile();
+};
+
+#endif
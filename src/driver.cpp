@@ -1,14 +1,24 @@
 #include "driver.hpp"
+#include "arena.hpp"
+#include "cache.hpp"
+#include "compiler.hpp"
 #include "errors.hpp"
 #include "format.hpp"
+#include "history.hpp"
 #include "interpreter.hpp"
+#include "jobs.hpp"
 #include "lexer.hpp"
 #include "parser.hpp"
+#include "report.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
 
-#include <fstream>
+#include <algorithm>
+#include <cstdio>
 #include <iomanip>
 #include <iostream>
-#include <iterator>
+#include <thread>
+#include <unistd.h>
 
 #define CONFIG_FILE "./quickbuild"
 
@@ -16,48 +26,74 @@ Driver::Driver(Setup setup) { m_setup = setup; }
 
 Setup Driver::default_setup() {
   return Setup{std::nullopt, InputMethod::ConfigFile, LoggingLevel::Standard,
-               false};
+               false, std::nullopt, false, std::nullopt, false, false, 0, false};
 }
 
-std::vector<unsigned char> Driver::get_config() {
+// note: the config is borrowed by every stage of the build, so it's never
+// copied after it has been loaded.
+InputBuffer Driver::get_config() {
   switch (m_setup.input_method) {
   case InputMethod::ConfigFile: {
-    std::ifstream config_file(CONFIG_FILE, std::ios::binary);
-    if (!config_file.is_open())
+    std::optional<InputBuffer> config = InputBuffer::map_file(CONFIG_FILE);
+    if (!config)
       throw DriverException("driver-d002: couldn't find config file");
-    return std::vector<unsigned char>(std::istreambuf_iterator(config_file),
-                                      {});
-  }
-  case InputMethod::Stdin: {
-    std::string line;
-    std::string all;
-    while (getline(std::cin, line))
-      all += line;
-    return std::vector<unsigned char>(all.begin(), all.end());
+    return std::move(*config);
   }
+  case InputMethod::Stdin:
+    return InputBuffer::read_stream(STDIN_FILENO);
   }
   __builtin_unreachable();
 }
 
-// todo: perhaps also slightly messy. refactor?
-std::string get_line(InputStreamPos pos, std::vector<unsigned char> config) {
-  int line_start = 0;
-  int line_end = 0;
-  for (size_t i = 0; i < pos.index && i < config.size(); i++) {
-    if (config[i] == '\n') {
-      line_start = i + 1;
+// the compiled program is cached for config files, so that lexing, parsing
+// and compiling are skipped entirely if no config file has changed.
+// otherwise, only the files that have changed are parsed again.
+IRProgram Driver::get_program(std::vector<ConfigSource> &sources,
+                              std::optional<InputBuffer> &cache,
+                              Arena &arena) {
+  bool cacheable = m_setup.input_method == InputMethod::ConfigFile;
+  if (cacheable && (cache = InputBuffer::map_file(CONFIG_CACHE_FILE))) {
+    TraceSpan span("load config cache", CONFIG_CACHE_FILE);
+    std::optional<IRProgram> program = ConfigCache::load(*cache, sources);
+    if (program) {
+      LOG_VERBOSE("  using cached config from " << CONFIG_CACHE_FILE);
+      return std::move(*program);
     }
+    cache.reset();
+  }
+
+  ConfigLoader loader(sources, cacheable);
+  AST ast = loader.load();
+  LOG_VERBOSE("  parsed " << sources.size() << " config file(s)");
+
+  TraceSpan compile_span("compile");
+  Compiler compiler = Compiler(ast, arena);
+  IRProgram program = compiler.compile();
+  compile_span.end();
+
+  if (cacheable) {
+    TraceSpan span("store config cache", CONFIG_CACHE_FILE);
+    if (!ConfigCache::store(program, sources, CONFIG_CACHE_FILE))
+      LOG_VERBOSE("  couldn't write config cache to " << CONFIG_CACHE_FILE);
   }
-  line_end = line_start;
-  for (size_t i = line_start; config[i] != '\n' && i < config.size(); i++)
-    line_end = i;
-  std::vector<unsigned char> line_vec(config.begin() + line_start,
-                                      config.begin() + line_end + 1);
-  return std::string(line_vec.begin(), line_vec.end());
+  return program;
+}
+
+// returns the line containing the position, without its newline.
+std::string_view get_line(InputStreamPos pos, std::string_view config) {
+  size_t index = std::min(pos.index, config.size());
+  size_t line_start = config.rfind('\n', index == 0 ? 0 : index - 1);
+  line_start = (line_start == std::string_view::npos || index == 0)
+                   ? 0
+                   : line_start + 1;
+  size_t line_end = config.find('\n', line_start);
+  if (line_end == std::string_view::npos)
+    line_end = config.size();
+  return config.substr(line_start, line_end - line_start);
 }
 
 // TODO: Not too bad, but consider a refactor
-void Driver::display_error_stack(std::vector<unsigned char> config) {
+void Driver::display_error_stack(std::vector<ConfigSource> const &sources) {
   std::optional<ErrorInfo> error_info;
   LOG_STANDARD(RED << "⮾ build stopped." << RESET
                    << " unwinding error stack...");
@@ -70,8 +106,14 @@ void Driver::display_error_stack(std::vector<unsigned char> config) {
                            : "");
     LOG_STANDARD(prefix << "├" << RED << "❬error #" << error_n
                         << "❭: " + error_info->message << ref << RESET);
-    if (error_info->context.stream_pos) {
-      std::string line_str = get_line(*error_info->context.stream_pos, config);
+    if (error_info->context.stream_pos &&
+        error_info->context.stream_pos->file < sources.size()) {
+      ConfigSource const &source =
+          sources[error_info->context.stream_pos->file];
+      std::string_view line_str =
+          get_line(*error_info->context.stream_pos, source.buffer.view());
+      if (sources.size() > 1)
+        LOG_STANDARD(prefix << "│ " << ITALIC << source.path << RESET);
       std::string underline;
       for (const auto &_ : line_str) {
         underline += "^";
@@ -90,33 +132,102 @@ void Driver::display_error_stack(std::vector<unsigned char> config) {
 }
 
 int Driver::run() {
+  if (m_setup.trace)
+    Trace::enable();
+  if (m_setup.stats)
+    Stats::enable();
+  size_t cores = std::max(1u, std::thread::hardware_concurrency());
+  Jobs::set_limit(m_setup.jobs ? m_setup.jobs : cores);
+  Jobs::set_keep_going(m_setup.keep_going);
+  Jobs::forward_signals();
+  int status = build();
+  if (m_setup.stats)
+    display_stats();
+  if (m_setup.trace && !Trace::write(*m_setup.trace))
+    LOG_STANDARD("  couldn't write trace to " << *m_setup.trace);
+  Log::flush();
+  return status;
+}
+
+void Driver::display_stats() {
+  Counters counters = Stats::collect();
+  auto count = [&counters](Counter counter) {
+    return counters[(size_t)counter];
+  };
+  char wait[32];
+  std::snprintf(wait, sizeof(wait), "%.2f ms",
+                count(Counter::EvaluationWaitNs) / 1e6);
+  LOG_STANDARD("⧗ build statistics");
+  LOG_STANDARD("  value cache:      " << count(Counter::ValueCacheHits)
+                                      << " hits, "
+                                      << count(Counter::ValueCacheMisses)
+                                      << " misses");
+  LOG_STANDARD("  iteration cache:  " << count(Counter::IterationCacheHits)
+                                      << " hits, "
+                                      << count(Counter::IterationCacheMisses)
+                                      << " misses");
+  LOG_STANDARD("  stat:             " << count(Counter::StatCalls)
+                                      << " calls, "
+                                      << count(Counter::StatCacheHits)
+                                      << " cached");
+  LOG_STANDARD("  glob:             " << count(Counter::Globs) << " globs, "
+                                      << count(Counter::GlobEntries)
+                                      << " entries visited");
+  LOG_STANDARD("  task lookups:     " << count(Counter::TaskLookups));
+  LOG_STANDARD("  evaluation lock:  "
+               << count(Counter::EvaluationLocks) << " acquired, " << wait
+               << " waiting");
+  LOG_STANDARD("  threads spawned:  " << count(Counter::ThreadsSpawned));
+  LOG_STANDARD("  commands run:     " << count(Counter::CommandsRun));
+}
+
+int Driver::build() {
   LOG_STANDARD(BOLD << "[ quickbuild dev v0.7.1 ]" << RESET);
 
-  // config needs to be fetched out of scope so that
-  // it can be read when unwinding the error stack.
+  // config files need to be fetched out of scope so that
+  // they can be read when unwinding the error stack.
   LOG_STANDARD("⧗ compiling config...");
-  std::vector<unsigned char> config = get_config();
+  std::vector<ConfigSource> sources;
+  sources.push_back({m_setup.input_method == InputMethod::Stdin ? "<stdin>"
+                                                               : CONFIG_FILE,
+                     get_config(), std::nullopt});
 
+  // folded strings and evaluated values are owned by these arenas (or the
+  // mapped caches), and are released at once when the build finishes.
+  Arena ast_arena;
+  Arena value_arena;
+  std::optional<InputBuffer> cache;
+  BuildReport report(m_setup);
+  BuildHistory history;
+  history.load(HISTORY_FILE);
+
+  bool success = true;
   try {
     // build script.
-    Lexer lexer(config);
-    std::vector<Token> token_stream;
-    token_stream = lexer.get_token_stream();
-
-    Parser parser = Parser(token_stream);
-    AST ast(parser.parse_tokens());
+    IRProgram program = get_program(sources, cache, ast_arena);
 
     // build task.
-    Interpreter interpreter(ast, m_setup);
+    Interpreter interpreter(program, m_setup, value_arena, &report, &history);
     interpreter.build();
 
   } catch (BuildException &e) {
-    display_error_stack(config);
+    display_error_stack(sources);
     LOG_STANDARD("");
+    success = false;
+  }
+
+  report.finish();
+  if (!history.store(HISTORY_FILE))
+    LOG_VERBOSE("  couldn't write build history to " << HISTORY_FILE);
+  if (m_setup.summary)
+    report.print();
+  if (m_setup.summary_json && !report.write_json(*m_setup.summary_json))
+    LOG_STANDARD("  couldn't write summary to " << *m_setup.summary_json);
+
+  if (!success) {
     LOG_STANDARD("➤ build " << RED << "failed" << RESET);
     return EXIT_FAILURE;
   }
-
   LOG_STANDARD("➤ build completed");
   return EXIT_SUCCESS;
 }
@@ -1,10 +1,16 @@
 #ifndef DRIVER_H
 #define DRIVER_H
 
+#include "arena.hpp"
+#include "compiler.hpp"
 #include "errors.hpp"
+#include "loader.hpp"
+
+#include "oslayer.hpp"
 
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 enum class InputMethod {
@@ -23,13 +29,24 @@ struct Setup {
   InputMethod input_method;
   LoggingLevel logging_level;
   bool dry_run;
+  std::optional<std::string> trace; // path of the chrome trace, if any.
+  bool summary;
+  std::optional<std::string> summary_json;
+  bool stats;
+  bool explain;
+  size_t jobs; // commands that run at once, 0 for one per core.
+  bool keep_going;
 };
 
 class Driver {
 private:
   Setup m_setup;
-  void display_error_stack(std::vector<unsigned char> config);
-  std::vector<unsigned char> get_config();
+  void display_error_stack(std::vector<ConfigSource> const &sources);
+  InputBuffer get_config();
+  IRProgram get_program(std::vector<ConfigSource> &sources,
+                        std::optional<InputBuffer> &cache, Arena &arena);
+  int build();
+  void display_stats();
 
 public:
   Driver(Setup);
@@ -1,6 +1,7 @@
 #include "errors.hpp"
 
 std::vector<ErrorInfo> ErrorHandler::error_stack = {};
+static std::mutex error_lock;
 
 // push an error onto the stack so that it can be traced later.
 void ErrorHandler::push_error(ErrorContext context, ErrorCode error_code) {
@@ -45,7 +46,8 @@ std::optional<ErrorInfo> ErrorHandler::peek_error() {
   return error_stack.back();
 }
 
-ErrorContext::ErrorContext(Origin const &origin) {
+ErrorContext::ErrorContext(Origin const &handle) {
+  OriginInfo origin = handle.info();
   if (std::holds_alternative<InputStreamPos>(origin)) {
     this->stream_pos = std::get<InputStreamPos>(origin);
     this->ref = std::nullopt;
@@ -68,7 +70,8 @@ ErrorContext::ErrorContext(ObjectReference const &ref) {
   this->ref = ref;
 }
 
-ErrorContext::ErrorContext(Origin const &origin, ObjectReference const &ref) {
+ErrorContext::ErrorContext(Origin const &handle, ObjectReference const &ref) {
+  OriginInfo origin = handle.info();
   if (std::holds_alternative<InputStreamPos>(origin)) {
     this->stream_pos = std::get<InputStreamPos>(origin);
     this->ref = std::nullopt;
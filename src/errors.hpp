@@ -23,6 +23,8 @@ enum ErrorCode {
   P_AST_INVALID_ESCAPE,
   P_AST_NO_CLOSE,
   P_EMPTY_EXPRESSION,
+  P_IMPORT_INVALID_PATH,
+  P_IMPORT_NOT_FOUND,
 
   // interpreter.
   _I_CONSTRUCTOR_EXPECTED_LITERAL,
@@ -37,6 +39,9 @@ enum ErrorCode {
   I_TYPE_DEPENDENCIES,
   I_TYPE_RUN,
   I_TYPE_PARALLEL,
+  I_TYPE_OUTPUTS,
+  I_TYPE_SIDE_EFFECTS,
+  I_TYPE_RESPONSE_FILES,
   I_NONZERO_PROCESS,
   I_SPECIFIED_TASK_NOT_FOUND,
   I_NO_TASKS,
@@ -64,8 +69,6 @@ struct ErrorInfo {
   std::string message;  // generated by table below.
 };
 
-static std::mutex error_lock;
-
 // error code: <message, description>
 const std::map<ErrorCode, std::string> _ERROR_LOOKUP_TABLE = {
     {P_NO_MATCH,
@@ -92,6 +95,9 @@ const std::map<ErrorCode, std::string> _ERROR_LOOKUP_TABLE = {
      "expected a closing square bracket, but none was encountered."},
     {P_EMPTY_EXPRESSION, "empty expressions are not allowed because their type "
                          "cannot be inferred."},
+    {P_IMPORT_INVALID_PATH,
+     "expected a plain string literal as the path of an import."},
+    {P_IMPORT_NOT_FOUND, "the imported config file couldn't be read."},
     {L_INVALID_SYMBOL,
      "encountered an invalid symbol and couldn't recover. make sure no "
      "erroneous characters are present in the config."},
@@ -109,6 +115,15 @@ const std::map<ErrorCode, std::string> _ERROR_LOOKUP_TABLE = {
     {I_TYPE_PARALLEL,
      "encountered an incorrect type while evaluating a field. make sure that "
      "the parallel specifier only contains a single boolean."},
+    {I_TYPE_OUTPUTS,
+     "encountered an incorrect type while evaluating a field. make sure that "
+     "the outputs field only contains one or more strings."},
+    {I_TYPE_SIDE_EFFECTS,
+     "encountered an incorrect type while evaluating a field. make sure that "
+     "the side effects specifier only contains a single boolean."},
+    {I_TYPE_RESPONSE_FILES,
+     "encountered an incorrect type while evaluating a field. make sure that "
+     "the response files specifier only contains a single boolean."},
     {I_NONZERO_PROCESS,
      "one or more commands failed and returned a non-zero exit value."},
     {I_SPECIFIED_TASK_NOT_FOUND, "the user-specified task does not exist."},
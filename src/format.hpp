@@ -1,56 +1,63 @@
 #ifndef FORMAT_H
 #define FORMAT_H
 
-#include <iostream>
-#include <mutex>
+#include "log.hpp"
 #include <ostream>
-#include <unistd.h>
+#include <string_view>
 
 // Disable coloured output if no interactive terminal is found
-#define GREEN (isatty(STDOUT_FILENO) ? "\033[32m" : "")
-#define RED (isatty(STDOUT_FILENO) ? "\033[31m" : "")
-#define CYAN (isatty(STDOUT_FILENO) ? "\033[36m" : "")
-#define BOLD (isatty(STDOUT_FILENO) ? "\033[1m" : "")
-#define RESET (isatty(STDOUT_FILENO) ? "\033[0m" : "")
-#define ITALIC (isatty(STDOUT_FILENO) ? "\033[3m" : "")
+#define GREEN (Log::colors() ? "\033[32m" : "")
+#define RED (Log::colors() ? "\033[31m" : "")
+#define CYAN (Log::colors() ? "\033[36m" : "")
+#define BOLD (Log::colors() ? "\033[1m" : "")
+#define RESET (Log::colors() ? "\033[0m" : "")
+#define ITALIC (Log::colors() ? "\033[3m" : "")
 
-static std::mutex io_lock;
+// writes a string as a json string literal.
+inline void write_json_string(std::ostream &out, std::string_view string) {
+  out << '"';
+  for (char c : string) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if ((unsigned char)c < 0x20) {
+      char const *hex = "0123456789abcdef";
+      out << "\\u00" << hex[(unsigned char)c >> 4] << hex[c & 0xf];
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
 
 #define LOG_VERBOSE(msg)                                                       \
   if (m_setup.logging_level >= LoggingLevel::Verbose) {                        \
-    io_lock.lock();                                                            \
-    std::cout << msg << std::endl;                                             \
-    io_lock.unlock();                                                          \
+    Log::begin() << msg;                                                       \
+    Log::end(true);                                                            \
   }
 #define LOG_STANDARD(msg)                                                      \
   if (m_setup.logging_level >= LoggingLevel::Standard) {                       \
-    io_lock.lock();                                                            \
-    std::cout << msg << std::endl;                                             \
-    io_lock.unlock();                                                          \
+    Log::begin() << msg;                                                       \
+    Log::end(true);                                                            \
   }
 #define LOG_QUIET(msg)                                                         \
   if (m_setup.logging_level >= LoggingLevel::Quiet) {                          \
-    io_lock.lock();                                                            \
-    std::cout << msg << std::endl;                                             \
-    io_lock.unlock();                                                          \
+    Log::begin() << msg;                                                       \
+    Log::end(true);                                                            \
   }
 #define LOG_VERBOSE_NO_NEWLINE(msg)                                            \
   if (m_setup.logging_level >= LoggingLevel::Verbose) {                        \
-    io_lock.lock();                                                            \
-    std::cout << msg << std::flush;                                            \
-    io_lock.unlock();                                                          \
+    Log::begin() << msg;                                                       \
+    Log::end(false);                                                           \
   }
 #define LOG_STANDARD_NO_NEWLINE(msg)                                           \
   if (m_setup.logging_level >= LoggingLevel::Standard) {                       \
-    io_lock.lock();                                                            \
-    std::cout << msg << std::flush;                                            \
-    io_lock.unlock();                                                          \
+    Log::begin() << msg;                                                       \
+    Log::end(false);                                                           \
   }
 #define LOG_QUIET_NO_NEWLINE(msg)                                              \
   if (m_setup.logging_level >= LoggingLevel::Quiet) {                          \
-    io_lock.lock();                                                            \
-    std::cout << msg << std::flush;                                            \
-    io_lock.unlock();                                                          \
+    Log::begin() << msg;                                                       \
+    Log::end(false);                                                           \
   }
 
 #endif
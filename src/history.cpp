@@ -0,0 +1,81 @@
+#include "history.hpp"
+#include "oslayer.hpp"
+
+#include <cstring>
+#include <filesystem>
+
+static constexpr char HISTORY_MAGIC[4] = {'Q', 'B', 'H', 'S'};
+
+// every entry is a path, prefixed by its length, followed by its duration.
+// note: like the caches, the history is stored in native byte order.
+void BuildHistory::load(std::string const &path) {
+  std::optional<InputBuffer> buffer = InputBuffer::map_file(path);
+  if (!buffer)
+    return;
+  std::string_view contents = buffer->view();
+  uint32_t version;
+  if (contents.size() < sizeof(HISTORY_MAGIC) + sizeof(version) ||
+      std::memcmp(contents.data(), HISTORY_MAGIC, sizeof(HISTORY_MAGIC)) != 0)
+    return;
+  std::memcpy(&version, contents.data() + sizeof(HISTORY_MAGIC),
+              sizeof(version));
+  if (version != HISTORY_VERSION)
+    return;
+
+  size_t offset = sizeof(HISTORY_MAGIC) + sizeof(version);
+  while (offset < contents.size()) {
+    uint32_t length;
+    uint64_t duration;
+    if (contents.size() - offset < sizeof(length))
+      break;
+    std::memcpy(&length, contents.data() + offset, sizeof(length));
+    offset += sizeof(length);
+    if (contents.size() - offset < length + sizeof(duration))
+      break;
+    PathId task(contents.substr(offset, length));
+    offset += length;
+    std::memcpy(&duration, contents.data() + offset, sizeof(duration));
+    offset += sizeof(duration);
+    if (task.id >= m_durations.size())
+      m_durations.resize(task.id + 1, 0);
+    m_durations[task.id] = duration;
+  }
+}
+
+// note: durations are rounded up, since 0 means unknown.
+void BuildHistory::record(PathId task, double wall) {
+  std::lock_guard<std::mutex> lock(m_lock);
+  m_recorded.push_back({task, (uint64_t)(wall * 1e6) + 1});
+}
+
+bool BuildHistory::store(std::string const &path) {
+  std::lock_guard<std::mutex> lock(m_lock);
+  if (m_recorded.empty())
+    return true;
+  for (auto const &[task, duration] : m_recorded) {
+    if (task.id >= m_durations.size())
+      m_durations.resize(task.id + 1, 0);
+    m_durations[task.id] = duration;
+  }
+  m_recorded.clear();
+
+  std::string out(HISTORY_MAGIC, sizeof(HISTORY_MAGIC));
+  uint32_t version = HISTORY_VERSION;
+  out.append(reinterpret_cast<char const *>(&version), sizeof(version));
+  for (uint32_t id = 1; id < m_durations.size(); id++) {
+    if (0 == m_durations[id])
+      continue;
+    PathId task;
+    task.id = id;
+    uint32_t length = task.view().size();
+    out.append(reinterpret_cast<char const *>(&length), sizeof(length));
+    out.append(task.view());
+    out.append(reinterpret_cast<char const *>(&m_durations[id]),
+               sizeof(m_durations[id]));
+  }
+
+  std::error_code ec;
+  std::filesystem::create_directories(
+      std::filesystem::path(path).parent_path(), ec);
+  return OSLayer::write_file_atomic(path, out);
+}
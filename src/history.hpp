@@ -0,0 +1,35 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "paths.hpp"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define HISTORY_FILE ".quickbuild/history.bin"
+#define HISTORY_VERSION 1
+
+// how long the commands of every task iteration took the last time they
+// ran, so that the scheduler can start the longest paths through the build
+// first. durations are in microseconds.
+class BuildHistory {
+private:
+  std::vector<uint64_t> m_durations; // indexed by path id, 0 if unknown.
+  std::vector<std::pair<PathId, uint64_t>> m_recorded;
+  std::mutex m_lock;
+
+public:
+  // an unreadable or outdated history is ignored.
+  void load(std::string const &path);
+  // the duration of the last build, or 0 if the task hasn't run before.
+  uint64_t estimate(PathId task) const {
+    return task.id < m_durations.size() ? m_durations[task.id] : 0;
+  }
+  void record(PathId task, double wall);
+  // merges the durations of this build into the previous ones.
+  bool store(std::string const &path);
+};
+
+#endif
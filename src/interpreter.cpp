@@ -1,8 +1,15 @@
 #include "interpreter.hpp"
 #include "filesystem"
 #include "format.hpp"
+#include "jobs.hpp"
 #include "oslayer.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <cstring>
+#include <ctime>
 #include <filesystem>
 #include <memory>
 #include <thread>
@@ -11,508 +18,573 @@
 #define DEPENDS_PARALLEL "depends_parallel"
 #define RUN "run"
 #define RUN_PARALLEL "run_parallel"
+#define OUTPUTS "outputs"
+#define SIDE_EFFECTS "side_effects"
+#define RESPONSE_FILES "response_files"
 
 struct QBVisitOrigin {
-  Origin operator()(IString qbstring) { return qbstring.origin; };
-  Origin operator()(IBool qbbool) { return qbbool.origin; };
-  Origin operator()(IList qblist) { return qblist.origin; };
+  Origin operator()(IString const &qbstring) { return qbstring.origin; };
+  Origin operator()(IBool const &qbbool) { return qbbool.origin; };
+  Origin operator()(IList const &qblist) { return qblist.origin; };
 };
 
-// constructors & casts for internal data types.
-IString::IString() {
-  this->origin = InternalNode{};
-  this->content = "";
-}
-IString::IString(Token token) {
-  if (token.type != TokenType::Literal)
-    ErrorHandler::push_error_throw(token.origin,
-                                   _I_CONSTRUCTOR_EXPECTED_LITERAL);
-  this->origin = token.origin;
-  this->content = std::get<CTX_STR>(*token.context);
+// evaluates compiled expressions on a shared value stack.
+struct IREvaluate {
+  IRProgram const &program;
+  EvaluationContext const &context;
+  EvaluationState &state;
+  IValue expression(uint32_t index);
+  IValue load(IRReference const &reference, bool no_glob, Origin origin);
+  IValue field(IRField const &field, bool use_globbing);
+  IValue interpolate(size_t count, Origin origin);
+  IValue make_list(size_t count, IRType type, Origin origin);
+  IValue replace(IValue const &identifier, IRPattern const &pattern,
+                 bool immutable, Origin origin);
+  IValue replace_dynamic(Origin origin);
 };
-IString::IString(std::string content, Origin origin) {
-  this->origin = origin;
-  this->content = content;
-}
-std::string IString::toString() const { return (this->content); };
-bool IString::operator==(IString const other) const {
-  return this->content == other.content;
-}
 
-IBool::IBool() {
-  this->origin = InternalNode{};
-  this->content = false;
-}
-IBool::IBool(Token token) {
-  if (token.type != TokenType::True && token.type != TokenType::False)
-    ErrorHandler::push_error_throw(token.origin, _I_CONSTRUCTOR_EXPECTED_BOOL);
-  this->origin = token.origin;
-  this->content = (token.type == TokenType::True);
-}
-IBool::IBool(bool content, Origin origin) {
-  this->origin = origin;
-  this->content = content;
-}
-bool IBool::operator==(IBool const other) const {
-  return this->content == other.content;
+// evaluation is serialised, so waiting for it is recorded when tracing.
+std::unique_lock<std::mutex> Interpreter::lock_evaluation() {
+  TraceSpan span("wait for evaluation", {}, TRACE_MIN_WAIT_NS);
+  Stats::add(Counter::EvaluationLocks);
+  if (!Stats::enabled())
+    return std::unique_lock<std::mutex>(evaluation_lock);
+  auto start = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> guard(evaluation_lock);
+  Stats::add(Counter::EvaluationWaitNs,
+             std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::steady_clock::now() - start)
+                 .count());
+  return guard;
 }
-IBool::operator bool() const { return (this->content); };
 
-IList::IList() {
-  this->origin = InternalNode{};
-  this->contents = std::vector<IString>();
-}
-IList::IList(std::variant<std::vector<IString>, std::vector<IBool>> contents) {
-  if (std::holds_alternative<std::vector<IString>>(contents)) {
-    std::vector<IString> contents_qbstring =
-        std::get<std::vector<IString>>(contents);
-    if (contents_qbstring.size() <= 0)
-      ErrorHandler::push_error_throw(InternalNode{},
-                                     _I_CONSTRUCTOR_EXPECTED_NONEMPTY);
-    this->contents = contents_qbstring;
-    this->origin = contents_qbstring[0].origin;
-  } else if (std::holds_alternative<std::vector<IBool>>(contents)) {
-    std::vector<IBool> contents_qbbool = std::get<std::vector<IBool>>(contents);
-    if (contents_qbbool.size() <= 0)
-      ErrorHandler::push_error_throw(InternalNode{},
-                                     _I_CONSTRUCTOR_EXPECTED_NONEMPTY);
-    this->contents = contents_qbbool;
-    this->origin = contents_qbbool[0].origin;
-  }
-}
-bool IList::holds_qbstring() const {
-  return (this->contents.index() == QBLIST_STR);
-}
-bool IList::holds_qbbool() const {
-  return (this->contents.index() == QBLIST_BOOL);
-}
-bool IList::operator==(IList const other) const {
-  return this->contents == other.contents;
+IValue Interpreter::evaluate_expression(uint32_t expression,
+                                        EvaluationContext const &context,
+                                        EvaluationState &state) {
+  // evaluation can amend shared data in the state.
+  std::unique_lock<std::mutex> guard = lock_evaluation();
+  // a previous evaluation might have been unwound by an error.
+  state.stack.clear();
+  return IREvaluate{m_program, context, state}.expression(expression);
 }
 
-// returns true if, and only if, the passed context can reach the caller.
-bool EvaluationContext::context_verify(EvaluationContext const other) const {
-  if (this->task_scope == other.task_scope &&
-      this->use_globbing == other.use_globbing)
-    return true;
-  if (this->task_scope == std::nullopt &&
-      this->use_globbing == other.use_globbing)
-    return true;
-  return false;
-}
-
-// visitor that evaluates an AST object recursively.
-struct ASTEvaluate {
-  AST &ast;
-  EvaluationContext context;
-  std::shared_ptr<EvaluationState> state;
-  IValue operator()(Identifier const &identifier);
-  IValue operator()(Literal const &literal);
-  IValue operator()(FormattedLiteral const &formatted_literal);
-  IValue operator()(List const &list);
-  IValue operator()(Boolean const &boolean);
-  IValue operator()(Replace const &replace);
-};
-
-IValue
-Interpreter::evaluate_ast_object(ASTObject ast_object, AST &ast,
-                                 EvaluationContext context,
-                                 std::shared_ptr<EvaluationState> state) {
-  // evaluation visitor can amend shared data in the state.
-  std::lock_guard<std::mutex> guard(evaluation_lock);
-  IValue value = std::visit(ASTEvaluate{ast, context, state}, ast_object);
-  return value;
-}
-
-IValue ASTEvaluate::operator()(Identifier const &identifier) {
-  // check for any cached values.
-  for (ValueInstance value : state->values) {
-    if (value.identifier == identifier &&
-        value.context.context_verify(context)) {
-      return value.result;
-    }
-  }
-
-  // task-specific fields.
-  if (context.task_scope) {
-    for (Field const &field : context.task_scope->fields) {
-      if (field.identifier.content == identifier.content) {
-        ASTEvaluate ast_visitor = {ast, context, state};
-        IValue result = std::visit(ast_visitor, field.expression);
-        if (result.immutable)
-          state->values.push_back(ValueInstance{identifier, context, result});
-        return result;
-      }
-    }
-  }
-
-  // task iteration variable - this isn't cached for obvious reasons.
-  if (context.task_iteration && context.task_scope)
-    if (context.task_scope->iterator.content == identifier.content)
-      return {IString(*context.task_iteration, context.task_scope->origin),
-              false};
-
-  // global fields.
-  for (Field const &field : ast.fields) {
-    if (field.identifier.content == identifier.content) {
-      ASTEvaluate ast_visitor = {
-          ast, EvaluationContext{std::nullopt, std::nullopt}, state};
-      IValue result = std::visit(ast_visitor, field.expression);
-      EvaluationContext _context =
-          EvaluationContext{std::nullopt, std::nullopt, context.use_globbing};
-      if (result.immutable)
-        state->values.push_back(ValueInstance{identifier, _context, result});
-      return result;
-    }
-  }
-
-  // identifier not found.
-  ErrorHandler::push_error_throw({identifier.origin, identifier.content},
-                                 I_NO_MATCHING_IDENTIFIER);
-  __builtin_unreachable();
-}
-
-// note: we handle globbing **after** evaluating a formatted literal.
-IValue ASTEvaluate::operator()(Literal const &literal) {
-  return {IString(literal.content, literal.origin)};
-};
-
 // helper method: handles globbing.
-IValue expand_literal(IString input_qbstring, bool immutable) {
+IValue expand_literal(IString const &input_qbstring, bool immutable,
+                      Arena &arena) {
   size_t i_asterisk = input_qbstring.content.find('*');
   if (i_asterisk == std::string::npos) // no globbing.
-    return {input_qbstring};
+    return {input_qbstring, immutable};
 
   // globbing is required.
-  std::string prefix = input_qbstring.content.substr(0, i_asterisk);
-  std::string suffix = input_qbstring.content.substr(i_asterisk + 1);
+  TraceSpan span("glob", input_qbstring.view());
+  Stats::add(Counter::Globs);
+  std::string_view prefix = input_qbstring.view().substr(0, i_asterisk);
+  std::string_view suffix = input_qbstring.view().substr(i_asterisk + 1);
 
-  // acts as a string vector.
-  IList matching_paths;
+  IStringList matching_paths;
   for (std::filesystem::directory_entry const &dir_entry :
        std::filesystem::recursive_directory_iterator(".")) {
-    std::string dir_path = dir_entry.path().string();
+    Stats::add(Counter::GlobEntries);
+    std::string const &dir_path = dir_entry.path().native();
     size_t i_prefix = dir_path.find(prefix);
     size_t i_suffix = dir_path.find(suffix);
     if (prefix.empty() && i_suffix != std::string::npos)
-      std::get<QBLIST_STR>(matching_paths.contents)
-          .push_back(IString(dir_path, input_qbstring.origin));
+      matching_paths.push_back(
+          IString(arena.copy_string(dir_path), input_qbstring.origin));
     else if (suffix.empty() && i_prefix != std::string::npos)
-      std::get<QBLIST_STR>(matching_paths.contents)
-          .push_back(IString(dir_path, input_qbstring.origin));
+      matching_paths.push_back(
+          IString(arena.copy_string(dir_path), input_qbstring.origin));
     else if (!prefix.empty() && !suffix.empty() &&
              i_prefix != std::string::npos && i_suffix != std::string::npos &&
              i_prefix < i_suffix)
-      std::get<QBLIST_STR>(matching_paths.contents)
-          .push_back(IString(dir_path, input_qbstring.origin));
+      matching_paths.push_back(
+          IString(arena.copy_string(dir_path), input_qbstring.origin));
   }
 
-  if (std::get<QBLIST_STR>(matching_paths.contents).size() > 0)
-    matching_paths.origin =
-        std::get<QBLIST_STR>(matching_paths.contents)[0].origin;
+  if (matching_paths.size() == 1)
+    return {matching_paths[0], immutable};
 
-  if (std::get<QBLIST_STR>(matching_paths.contents).size() == 1)
-    return {std::get<QBLIST_STR>(matching_paths.contents)[0]};
-
-  return {matching_paths, immutable};
+  Origin origin = matching_paths.empty() ? Origin{InternalNode{}}
+                                         : matching_paths.origins[0];
+  return {IList(std::move(matching_paths), origin), immutable};
 }
 
-// note: if literal includes a `*`, globbing will be used - this is
-// expensive.
-IValue ASTEvaluate::operator()(FormattedLiteral const &formatted_literal) {
-  IString out;
-  bool immutable = true;
-  for (ASTObject const &ast_obj : formatted_literal.contents) {
-    ASTEvaluate ast_visitor = {ast, context, state};
-    IValue obj_result = std::visit(ast_visitor, ast_obj);
-    // append a string.
-    if (std::holds_alternative<IString>(obj_result.value)) {
-      if (std::holds_alternative<InternalNode>(out.origin))
-        out.origin = std::get<IString>(obj_result.value).origin;
-      out.content += std::get<IString>(obj_result.value).content;
-      immutable &= obj_result.immutable;
+// note: the stack may be reallocated by nested loads, so references into it
+// mustn't be held across instructions.
+IValue IREvaluate::expression(uint32_t index) {
+  IRExpression const &expression = program.expressions[index];
+  std::vector<IValue> &stack = state.stack;
+  size_t base = stack.size();
+
+  for (uint32_t pc = expression.begin; pc < expression.end; pc++) {
+    IRInstruction const &instruction = program.code[pc];
+    switch (instruction.opcode) {
+    case IROpCode::Constant:
+      stack.push_back(program.constants[instruction.operand]);
+      break;
+    case IROpCode::Load: {
+      IValue value = load(program.references[instruction.operand],
+                          instruction.no_glob, program.origins[pc]);
+      stack.push_back(std::move(value));
+      break;
     }
-    // append a bool.
-    else if (std::holds_alternative<IBool>(obj_result.value)) {
-      if (std::holds_alternative<InternalNode>(out.origin))
-        out.origin = std::get<IBool>(obj_result.value).origin;
-      out.content += (std::get<IBool>(obj_result.value) ? "true" : "false");
-      immutable &= obj_result.immutable;
+    case IROpCode::Interpolate: {
+      IValue value = interpolate(instruction.count, program.origins[pc]);
+      stack.erase(stack.end() - instruction.count, stack.end());
+      stack.push_back(std::move(value));
+      break;
     }
-    // append a list of strings.
-    else if (std::holds_alternative<IList>(obj_result.value) &&
-             std::get<IList>(obj_result.value).contents.index() == QBLIST_STR) {
-      IList obj_result_list = std::get<IList>(obj_result.value);
-      for (size_t i = 0;
-           i < std::get<QBLIST_STR>(obj_result_list.contents).size(); i++) {
-        if (std::holds_alternative<InternalNode>(out.origin))
-          out.origin = std::get<QBLIST_STR>(obj_result_list.contents)[i].origin;
-        out.content +=
-            std::get<QBLIST_STR>(obj_result_list.contents)[i].content;
-        immutable &= obj_result.immutable;
-        if (i < std::get<QBLIST_STR>(obj_result_list.contents).size() - 1)
-          out.content.append(" ");
-      }
+    case IROpCode::Glob:
+      // note: if literal includes a `*`, globbing will be used - this is
+      // expensive.
+      if (context.use_globbing &&
+          std::holds_alternative<IString>(stack.back().value))
+        stack.back() = expand_literal(std::get<IString>(stack.back().value),
+                                      stack.back().immutable, state.arena);
+      break;
+    case IROpCode::MakeList: {
+      IValue value =
+          make_list(instruction.count, instruction.type, program.origins[pc]);
+      stack.erase(stack.end() - instruction.count, stack.end());
+      stack.push_back(std::move(value));
+      break;
+    }
+    case IROpCode::Replace: {
+      IValue identifier = std::move(stack.back());
+      stack.pop_back();
+      stack.push_back(replace(identifier,
+                              program.patterns[instruction.operand],
+                              identifier.immutable, program.origins[pc]));
+      break;
+    }
+    case IROpCode::ReplaceDynamic: {
+      IValue value = replace_dynamic(program.origins[pc]);
+      stack.erase(stack.end() - 3, stack.end());
+      stack.push_back(std::move(value));
+      break;
     }
-    // append a list of bools.
-    else if (std::holds_alternative<IList>(obj_result.value) &&
-             std::get<IList>(obj_result.value).contents.index() ==
-                 QBLIST_BOOL) {
-      IList obj_result_list = std::get<IList>(obj_result.value);
-      for (size_t i = 0;
-           i < std::get<QBLIST_BOOL>(obj_result_list.contents).size(); i++) {
-        if (std::holds_alternative<InternalNode>(out.origin))
-          out.origin =
-              std::get<QBLIST_BOOL>(obj_result_list.contents)[i].origin;
-        out.content +=
-            (std::get<QBLIST_BOOL>(obj_result_list.contents)[i] ? "true"
-                                                                : "false");
-        immutable &= obj_result.immutable;
-        if (i < std::get<QBLIST_BOOL>(obj_result_list.contents).size() - 1)
-          out.content.append(" ");
-      }
     }
   }
 
-  if (context.use_globbing)
-    return expand_literal(out, immutable);
-  else
-    return {out, immutable};
+  IValue result = std::move(stack.back());
+  stack.resize(base, IValue{});
+  return result;
 }
 
-IValue ASTEvaluate::operator()(List const &list) {
-  if (list.contents.size() <= 0)
-    ErrorHandler::push_error_throw(InternalNode{},
-                                   _I_EVALUATE_EXPECTED_NONEMPTY);
+IValue IREvaluate::load(IRReference const &reference, bool no_glob,
+                        Origin origin) {
+  switch (reference.kind) {
+  case IRReferenceKind::Field:
+    // wildcards are handled separately inside of replacements.
+    return field(program.fields[reference.field],
+                 no_glob ? false : context.use_globbing);
+  case IRReferenceKind::Iterator:
+    // task iteration variable - this isn't cached for obvious reasons.
+    if (context.task_iteration && context.task_scope)
+      return {IString(context.task_iteration->view(),
+                      context.task_scope->origin),
+              false};
+    break;
+  case IRReferenceKind::Unresolved:
+    break;
+  }
+
+  // identifier not found.
+  ErrorHandler::push_error_throw({origin, std::string(reference.name)},
+                                 I_NO_MATCHING_IDENTIFIER);
+  __builtin_unreachable();
+}
+
+IValue IREvaluate::field(IRField const &field, bool use_globbing) {
+  // global fields are always evaluated in the global scope.
+  EvaluationContext field_context =
+      field.global ? EvaluationContext{}
+                   : EvaluationContext{context.task_scope,
+                                       context.task_iteration, use_globbing};
+  size_t slot = field.id * 2 + field_context.use_globbing;
+  if (state.values[slot]) {
+    Stats::add(Counter::ValueCacheHits);
+    return *state.values[slot];
+  }
+
+  // values that depend on the iteration are cached per iteration.
+  bool iterated = !field.global && field_context.task_iteration;
+  if (iterated) {
+    auto it = state.iteration_values.find(
+        {(uint32_t)slot, *field_context.task_iteration});
+    if (it != state.iteration_values.end()) {
+      Stats::add(Counter::IterationCacheHits);
+      return it->second;
+    }
+  }
+  Stats::add(iterated ? Counter::IterationCacheMisses
+                      : Counter::ValueCacheMisses);
+
+  TraceSpan span("evaluate", field.name);
+  IValue result = IREvaluate{program, field_context, state}.expression(
+      field.expression);
+  span.end();
+  // the iteration is irrelevant for immutable values.
+  if (result.immutable)
+    state.values[slot] = result;
+  else if (iterated)
+    state.iteration_values.emplace(
+        IterationKey{(uint32_t)slot, *field_context.task_iteration}, result);
+  return result;
+}
 
-  IList out;
+// joins the topmost `count` values of the stack into a single string. the
+// result is sized first and then written into a single arena allocation.
+IValue IREvaluate::interpolate(size_t count, Origin origin) {
+  auto begin = state.stack.end() - count;
+
+  // lists are joined with spaces.
+  size_t size = 0;
   bool immutable = true;
-  // infer the list type. todo: consider a cleaner solution.
-  ASTEvaluate ast_visitor = {ast, context, state};
-  IValue _obj_result = std::visit(ast_visitor, list.contents[0]);
-  out.origin = list.origin; // std::visit(QBVisitOrigin{}, _obj_result.value);
-  if (std::holds_alternative<IString>(_obj_result.value)) {
-    out.contents = std::vector<IString>();
-  } else if (std::holds_alternative<IBool>(_obj_result.value)) {
-    out.contents = std::vector<IBool>();
-  } else if (std::holds_alternative<IList>(_obj_result.value)) {
-    IList __obj_qblist = std::get<IList>(_obj_result.value);
-    if (std::holds_alternative<std::vector<IString>>(__obj_qblist.contents))
-      out.contents = std::vector<IString>();
-    else if (std::holds_alternative<std::vector<IBool>>(__obj_qblist.contents))
-      out.contents = std::vector<IBool>();
-  }
-
-  // add the early evaluated first element.
-  if (std::holds_alternative<IString>(_obj_result.value)) {
-    std::get<QBLIST_STR>(out.contents)
-        .push_back(std::get<IString>(_obj_result.value));
-    immutable &= _obj_result.immutable;
-  } else if (std::holds_alternative<IBool>(_obj_result.value)) {
-    std::get<QBLIST_BOOL>(out.contents)
-        .push_back(std::get<IBool>(_obj_result.value));
-    immutable &= _obj_result.immutable;
-  } else if (std::holds_alternative<IList>(_obj_result.value)) {
-    IList obj_result_qblist = std::get<IList>(_obj_result.value);
-    if (obj_result_qblist.holds_qbstring() && out.holds_qbstring()) {
-      std::get<QBLIST_STR>(out.contents)
-          .insert(std::get<QBLIST_STR>(out.contents).begin(),
-                  std::get<QBLIST_STR>(obj_result_qblist.contents).begin(),
-                  std::get<QBLIST_STR>(obj_result_qblist.contents).end());
-      immutable &= _obj_result.immutable;
-    } else if (obj_result_qblist.holds_qbbool() && out.holds_qbbool()) {
-      std::get<QBLIST_BOOL>(out.contents)
-          .insert(std::get<QBLIST_BOOL>(out.contents).begin(),
-                  std::get<QBLIST_BOOL>(obj_result_qblist.contents).begin(),
-                  std::get<QBLIST_BOOL>(obj_result_qblist.contents).end());
-      immutable &= _obj_result.immutable;
+  for (auto it = begin; it != state.stack.end(); it++) {
+    immutable &= it->immutable;
+    if (std::holds_alternative<IString>(it->value)) {
+      size += std::get<IString>(it->value).content.size();
+    } else if (std::holds_alternative<IBool>(it->value)) {
+      size += std::get<IBool>(it->value) ? 4 : 5;
+    } else if (std::get<IList>(it->value).holds_qbstring()) {
+      IStringList const &strings = std::get<IList>(it->value).strings();
+      for (std::string_view string : strings.contents)
+        size += string.size() + 1;
+      size -= !strings.empty();
+    } else {
+      IBoolList const &bools = std::get<IList>(it->value).bools();
+      for (bool qbbool : bools.contents)
+        size += (qbbool ? 4 : 5) + 1;
+      size -= !bools.empty();
+    }
+  }
+
+  char *buffer = static_cast<char *>(state.arena.allocate(size + 1, 1));
+  char *out = buffer;
+  // long commands might have their lists spilled into response files. the
+  // expansions of interpolated strings are carried over.
+  std::vector<IExpansion> expansions;
+  bool record_expansions = size > RESPONSE_FILE_THRESHOLD;
+  auto write = [&out](std::string_view string) {
+    std::memcpy(out, string.data(), string.size());
+    out += string.size();
+  };
+  for (auto it = begin; it != state.stack.end(); it++) {
+    if (std::holds_alternative<IString>(it->value)) {
+      IString const &string = std::get<IString>(it->value);
+      size_t offset = out - buffer;
+      if (string.expansions) {
+        for (IExpansion const &expansion : *string.expansions)
+          expansions.push_back(
+              {offset + expansion.begin, offset + expansion.end});
+      }
+      write(string.content);
+    } else if (std::holds_alternative<IBool>(it->value)) {
+      write(std::get<IBool>(it->value) ? "true" : "false");
+    } else if (std::get<IList>(it->value).holds_qbstring()) {
+      IStringList const &strings = std::get<IList>(it->value).strings();
+      size_t expansion_begin = out - buffer;
+      for (size_t i = 0; i < strings.size(); i++) {
+        if (i > 0)
+          *out++ = ' ';
+        write(strings.contents[i]);
+      }
+      size_t expansion_end = out - buffer;
+      if (strings.size() > 1 &&
+          (record_expansions || expansion_end - expansion_begin >=
+                                    RESPONSE_FILE_MIN_EXPANSION))
+        expansions.push_back({expansion_begin, expansion_end});
+    } else {
+      IBoolList const &bools = std::get<IList>(it->value).bools();
+      for (size_t i = 0; i < bools.size(); i++) {
+        if (i > 0)
+          *out++ = ' ';
+        write(bools.contents[i] ? "true" : "false");
+      }
     }
   }
+  *out = '\0';
+  IString out_qbstring(std::string_view(buffer, size), origin);
+  if (!expansions.empty())
+    out_qbstring.expansions =
+        state.arena.make<std::vector<IExpansion>>(std::move(expansions));
+  return {out_qbstring, immutable};
+}
+
+// flattens the topmost `count` values of the stack into a single list.
+IValue IREvaluate::make_list(size_t count, IRType type, Origin origin) {
+  if (count <= 0)
+    ErrorHandler::push_error_throw(InternalNode{},
+                                   _I_EVALUATE_EXPECTED_NONEMPTY);
+
+  // infer the list type from the first element, unless it's already known.
+  auto first = state.stack.end() - count;
+  IListContents out;
+  if (type == IRType::BoolList || std::holds_alternative<IBool>(first->value) ||
+      (std::holds_alternative<IList>(first->value) &&
+       std::get<IList>(first->value).holds_qbbool()))
+    out = IBoolList();
+  else
+    out = IStringList();
+  if (type == IRType::StringList)
+    std::get<QBLIST_STR>(out).reserve(count);
 
-  for (size_t i = 1; i < list.contents.size(); i++) {
-    ASTObject ast_obj = list.contents[i];
-    ASTEvaluate ast_visitor = {ast, context, state};
-    IValue obj_result = std::visit(ast_visitor, ast_obj);
+  bool immutable = true;
+  for (auto it = first; it != state.stack.end(); it++) {
+    IValue const &obj_result = *it;
+    immutable &= obj_result.immutable;
     if (std::holds_alternative<IString>(obj_result.value)) {
-      if (out.holds_qbstring()) {
-        std::get<QBLIST_STR>(out.contents)
-            .push_back(std::get<IString>(obj_result.value));
-        immutable &= _obj_result.immutable;
-      } else
+      if (out.index() == QBLIST_STR)
+        std::get<QBLIST_STR>(out).push_back(
+            std::get<IString>(obj_result.value));
+      else
         ErrorHandler::push_error_throw(
-            {out.origin, std::get<IString>(obj_result.value).toString()},
+            {origin, std::get<IString>(obj_result.value).toString()},
             I_EVALUATE_LIST_TYPE_MISMATCH);
     } else if (std::holds_alternative<IBool>(obj_result.value)) {
-      if (out.holds_qbbool()) {
-        std::get<QBLIST_BOOL>(out.contents)
-            .push_back(std::get<IBool>(obj_result.value));
-        immutable &= _obj_result.immutable;
-      } else
+      if (out.index() == QBLIST_BOOL)
+        std::get<QBLIST_BOOL>(out).push_back(std::get<IBool>(obj_result.value));
+      else
         ErrorHandler::push_error_throw(
-            {out.origin, std::get<IBool>(obj_result.value) ? "true" : "false"},
+            {origin, std::get<IBool>(obj_result.value) ? "true" : "false"},
             I_EVALUATE_LIST_TYPE_MISMATCH);
-    } else if (std::holds_alternative<IList>(obj_result.value)) {
-      IList obj_result_qblist = std::get<IList>(obj_result.value);
-      if (obj_result_qblist.holds_qbstring() && out.holds_qbstring()) {
-        std::get<QBLIST_STR>(out.contents)
-            .insert(std::get<QBLIST_STR>(out.contents).end(),
-                    std::get<QBLIST_STR>(obj_result_qblist.contents).begin(),
-                    std::get<QBLIST_STR>(obj_result_qblist.contents).end());
-        immutable &= _obj_result.immutable;
-      } else if (obj_result_qblist.holds_qbbool() && out.holds_qbbool()) {
-        std::get<QBLIST_BOOL>(out.contents)
-            .insert(std::get<QBLIST_BOOL>(out.contents).end(),
-                    std::get<QBLIST_BOOL>(obj_result_qblist.contents).begin(),
-                    std::get<QBLIST_BOOL>(obj_result_qblist.contents).end());
-        immutable &= _obj_result.immutable;
+    } else {
+      IList const &obj_result_qblist = std::get<IList>(obj_result.value);
+      if (obj_result_qblist.holds_qbstring() && out.index() == QBLIST_STR) {
+        std::get<QBLIST_STR>(out).append(obj_result_qblist.strings());
+      } else if (obj_result_qblist.holds_qbbool() &&
+                 out.index() == QBLIST_BOOL) {
+        std::get<QBLIST_BOOL>(out).append(obj_result_qblist.bools());
       } else {
-        ErrorHandler::push_error_throw(out.origin,
-                                       I_EVALUATE_LIST_TYPE_MISMATCH);
+        ErrorHandler::push_error_throw(origin, I_EVALUATE_LIST_TYPE_MISMATCH);
       }
     }
   }
 
-  return {out, immutable};
-};
-
-IValue ASTEvaluate::operator()(Boolean const &boolean) {
-  return {IBool(boolean.content, boolean.origin)};
-};
-
-IValue ASTEvaluate::operator()(Replace const &replace) {
-  // override use_globbing to false, we want to handle the wildcards
-  // separately.
-  EvaluationContext _context =
-      EvaluationContext{context.task_scope, context.task_iteration, false};
-  ASTEvaluate ast_visitor = {ast, _context, state};
-  IValue identifier = std::visit(ast_visitor, *replace.identifier);
-  IValue original = std::visit(ast_visitor, *replace.original);
-  IValue replacement = std::visit(ast_visitor, *replace.replacement);
-
-  bool immutable = true;
-  immutable &= identifier.immutable;
-  immutable &= original.immutable;
-  immutable &= replacement.immutable;
+  return {IList(std::move(out), origin), immutable};
+}
 
-  if (!std::holds_alternative<IString>(original.value) ||
-      !std::holds_alternative<IString>(replacement.value))
-    ErrorHandler::push_error_throw(std::visit(QBVisitOrigin{}, original.value),
-                                   I_EVALUATE_REPLACE_TYPE_ERROR);
+// locates `chunk` in `haystack`, starting at `offset`. candidates are found
+// by scanning for the first byte of the chunk with memchr.
+static size_t find_chunk(std::string_view haystack, std::string_view chunk,
+                         size_t offset) {
+  if (offset > haystack.size())
+    return std::string_view::npos;
+  if (chunk.empty())
+    return offset;
+
+  char const *begin = haystack.data();
+  char const *end = begin + haystack.size();
+  char const *it = begin + offset;
+  while ((size_t)(end - it) >= chunk.size()) {
+    it = static_cast<char const *>(
+        std::memchr(it, chunk[0], (end - it) - chunk.size() + 1));
+    if (!it)
+      return std::string_view::npos;
+    if (0 == std::memcmp(it + 1, chunk.data() + 1, chunk.size() - 1))
+      return it - begin;
+    it++;
+  }
+  return std::string_view::npos;
+}
 
-  IList input;
-  IList output;
+// applies a pattern to every string of the input in two passes: the first
+// locates the chunks and sizes the output, the second writes every
+// replaced string into a single buffer.
+IValue IREvaluate::replace(IValue const &identifier, IRPattern const &pattern,
+                           bool immutable, Origin origin) {
+  IStringList single;
+  IStringList const *input = nullptr;
   if (std::holds_alternative<IList>(identifier.value) &&
-      std::get<IList>(identifier.value).holds_qbstring())
-    input = std::get<IList>(identifier.value);
-  else if (std::holds_alternative<IString>(identifier.value))
-    std::get<QBLIST_STR>(input.contents)
-        .push_back(std::get<IString>(identifier.value));
-  else
+      std::get<IList>(identifier.value).holds_qbstring()) {
+    input = &std::get<IList>(identifier.value).strings();
+  } else if (std::holds_alternative<IString>(identifier.value)) {
+    single.push_back(std::get<IString>(identifier.value));
+    input = &single;
+  } else
     ErrorHandler::push_error_throw(
         std::visit(QBVisitOrigin{}, identifier.value),
         I_EVALUATE_REPLACE_TYPE_ERROR);
 
-  // split original and replacement into chunks.
-  std::vector<std::string> original_chunked;
-  std::stringstream original_ss(std::get<IString>(original.value).toString());
-  std::string original_buf;
-  while (std::getline(original_ss, original_buf, '*'))
-    original_chunked.push_back(original_buf);
-  std::vector<std::string> replacement_chunked;
-  std::stringstream replacement_ss(
-      std::get<IString>(replacement.value).toString());
-  std::string replacement_buf;
-  while (std::getline(replacement_ss, replacement_buf, '*'))
-    replacement_chunked.push_back(replacement_buf);
-
-  if (original_chunked.size() < replacement_chunked.size())
-    ErrorHandler::push_error_throw(replace.origin,
-                                   I_REPLACE_CHUNKS_LENGTH_ERROR);
-
-  // actual string manipulation.
-  for (IString const &qbstring : std::get<QBLIST_STR>(input.contents)) {
-    // split input into sections as delimited by the original chunks.
-    std::vector<std::string> input_chunked;
-    size_t last_token_i = 0;
-    for (std::string original_token : original_chunked) {
-      size_t token_i = qbstring.toString().find(original_token, last_token_i);
-      if (token_i == std::string::npos) {
-        std::get<QBLIST_STR>(output.contents).push_back(qbstring);
-        last_token_i = std::string::npos;
+  if (pattern.original.size() < pattern.replacement.size())
+    ErrorHandler::push_error_throw(origin, I_REPLACE_CHUNKS_LENGTH_ERROR);
+
+  // the end of every matched chunk, or npos if the string didn't match.
+  size_t const input_size = input->size();
+  size_t const chunks = pattern.original.size();
+  std::vector<size_t> &matches = state.replace_matches;
+  matches.assign(input_size * (chunks + 1), std::string_view::npos);
+  size_t output_size = 0;
+  for (size_t i = 0; i < input_size; i++) {
+    std::string_view string = input->contents[i];
+    size_t *match = &matches[i * (chunks + 1)];
+    size_t offset = 0;
+    size_t removed = 0;
+    size_t c = 0;
+    for (; c < chunks; c++) {
+      size_t token_i = find_chunk(string, pattern.original[c], offset);
+      if (token_i == std::string_view::npos)
         break;
-      }
-      input_chunked.push_back(
-          qbstring.toString().substr(last_token_i, (token_i - last_token_i)));
-      last_token_i = token_i + original_token.length();
+      match[c] = token_i;
+      offset = token_i + pattern.original[c].size();
+      removed += pattern.original[c].size();
     }
-    if (last_token_i == std::string::npos)
+    if (c < chunks)
+      continue;
+    match[chunks] = 0; // marks the string as matched.
+    output_size += string.size() - removed + pattern.replacement_size + 1;
+  }
+
+  char *buffer = nullptr;
+  if (output_size > 0)
+    buffer = static_cast<char *>(state.arena.allocate(output_size, 1));
+
+  IStringList output;
+  output.reserve(input_size);
+  for (size_t i = 0; i < input_size; i++) {
+    size_t const *match = &matches[i * (chunks + 1)];
+    if (match[chunks] == std::string_view::npos) {
+      output.push_back((*input)[i]);
       continue;
-    // last element.
-    input_chunked.push_back(qbstring.toString().substr(last_token_i));
-
-    // reconstruct new element from the chunked input and chunked
-    // replacement.
-    std::string reconstructed;
-    for (size_t i = 0; i < input_chunked.size() - 1; i++) {
-      reconstructed += input_chunked[i];
-      reconstructed += replacement_chunked[i];
     }
-    // last element.
-    reconstructed += input_chunked[input_chunked.size() - 1];
-    std::get<QBLIST_STR>(output.contents)
-        .push_back(IString(reconstructed, replace.origin));
+
+    // interleave the sections between the chunks with the replacement.
+    std::string_view string = input->contents[i];
+    char *out = buffer;
+    size_t offset = 0;
+    for (size_t c = 0; c < chunks; c++) {
+      std::memcpy(out, string.data() + offset, match[c] - offset);
+      out += match[c] - offset;
+      if (c < pattern.replacement.size()) {
+        std::memcpy(out, pattern.replacement[c].data(),
+                    pattern.replacement[c].size());
+        out += pattern.replacement[c].size();
+      }
+      offset = match[c] + pattern.original[c].size();
+    }
+    std::memcpy(out, string.data() + offset, string.size() - offset);
+    out += string.size() - offset;
+    *out = '\0';
+    output.push_back(IString(std::string_view(buffer, out - buffer), origin));
+    buffer = out + 1;
   }
   // todo: consider returning a single qbstring if list only contains one
   // item.
-  return {output, immutable};
-};
+  return {IList(std::move(output), InternalNode{}), immutable};
+}
+
+// patterns that couldn't be folded are split on every evaluation.
+IValue IREvaluate::replace_dynamic(Origin origin) {
+  IValue const &identifier = *(state.stack.end() - 3);
+  IValue const &original = *(state.stack.end() - 2);
+  IValue const &replacement = *(state.stack.end() - 1);
+  bool immutable =
+      identifier.immutable && original.immutable && replacement.immutable;
+
+  if (!std::holds_alternative<IString>(original.value) ||
+      !std::holds_alternative<IString>(replacement.value))
+    ErrorHandler::push_error_throw(std::visit(QBVisitOrigin{}, original.value),
+                                   I_EVALUATE_REPLACE_TYPE_ERROR);
+
+  IRPattern pattern =
+      IRPattern::split(std::get<IString>(original.value).content,
+                       std::get<IString>(replacement.value).content);
+  return replace(identifier, pattern, immutable, origin);
+}
 
-Interpreter::Interpreter(AST &ast, Setup setup) : m_ast(ast) {
+Interpreter::Interpreter(IRProgram const &program, Setup setup, Arena &arena,
+                         BuildReport *report, BuildHistory *history)
+    : m_program(program), m_arena(arena), m_report(report),
+      m_history(history) {
   m_setup = setup;
+  this->state = std::make_unique<EvaluationState>(m_arena);
+  this->state->values.resize(m_program.fields.size() * 2);
 }
 
-std::optional<Task> Interpreter::find_task(IString identifier) {
-  for (Task task : m_ast.tasks) {
-    IValue task_i = evaluate_ast_object(task.identifier, m_ast,
-                                        {std::nullopt, std::nullopt}, state);
-    if (std::holds_alternative<IString>(task_i.value) &&
-        std::get<IString>(task_i.value) == identifier) {
-      return task;
-    } else if (std::holds_alternative<IList>(task_i.value) &&
-               std::get<IList>(task_i.value).holds_qbstring()) {
-      for (IString task_j :
-           std::get<QBLIST_STR>(std::get<IList>(task_i.value).contents)) {
-        if (task_j == identifier)
-          return task;
-      }
-    }
+// evaluates the identifier of every task once. task identifiers are always
+// evaluated in the global scope, so they can't change during the build.
+// note: has to be called with the evaluation lock held. the index is only
+// marked as built once every identifier has been evaluated, so that an
+// evaluation error can't leave a partial index behind.
+void Interpreter::build_task_index() {
+  if (m_task_index_built)
+    return;
+  m_task_index.clear();
+  state->stack.clear();
+  auto add = [this](std::string_view identifier, IRTask const *task) {
+    PathId path(identifier);
+    if (path.id >= m_task_index.size())
+      m_task_index.resize(path.id + 1, nullptr);
+    // note: the first task that matches is kept.
+    if (!m_task_index[path.id])
+      m_task_index[path.id] = task;
+  };
+  for (IRTask const &task : m_program.tasks) {
+    IValue task_i =
+        IREvaluate{m_program, {}, *state}.expression(task.identifier);
+    if (std::holds_alternative<IString>(task_i.value))
+      add(std::get<IString>(task_i.value).view(), &task);
+    else if (std::holds_alternative<IList>(task_i.value) &&
+             std::get<IList>(task_i.value).holds_qbstring())
+      for (std::string_view task_j :
+           std::get<IList>(task_i.value).strings().contents)
+        add(task_j, &task);
   }
-  return std::nullopt;
+  m_task_index_built = true;
 }
 
-std::optional<Field> Interpreter::find_field(std::string identifier,
-                                             std::optional<Task> task) {
-  // task-specific fields.
-  if (task)
-    for (Field const &field : task->fields)
-      if (field.identifier.content == identifier)
-        return field;
-
-  // global fields.
-  for (Field const &field : m_ast.fields) {
-    if (field.identifier.content == identifier) {
-      return field;
-    }
+IRTask const *Interpreter::find_task(PathId identifier) {
+  Stats::add(Counter::TaskLookups);
+  {
+    std::unique_lock<std::mutex> guard = lock_evaluation();
+    build_task_index();
+  }
+  // the index is never modified once it's built.
+  return identifier.id < m_task_index.size() ? m_task_index[identifier.id]
+                                             : nullptr;
+}
+
+IValue Interpreter::evaluate_field(IRField const &field,
+                                   EvaluationContext const &context,
+                                   EvaluationState &state) {
+  std::unique_lock<std::mutex> guard = lock_evaluation();
+  state.stack.clear();
+  return IREvaluate{m_program, context, state}.field(field,
+                                                     context.use_globbing);
+}
+
+// resolves the task of every dependency at once.
+std::vector<IRTask const *>
+Interpreter::find_tasks(std::vector<PathId> const &identifiers) {
+  Stats::add(Counter::TaskLookups, identifiers.size());
+  {
+    std::unique_lock<std::mutex> guard = lock_evaluation();
+    build_task_index();
   }
-  return std::nullopt;
+  std::vector<IRTask const *> tasks;
+  tasks.reserve(identifiers.size());
+  for (PathId identifier : identifiers)
+    tasks.push_back(identifier.id < m_task_index.size()
+                        ? m_task_index[identifier.id]
+                        : nullptr);
+  return tasks;
+}
+
+// interns every dependency, so that it's only hashed and stat'ed once.
+static std::vector<PathId> intern_paths(IStringList const &strings) {
+  std::vector<PathId> paths;
+  paths.reserve(strings.size());
+  for (std::string_view string : strings.contents)
+    paths.emplace_back(string);
+  return paths;
 }
 
-IValue
-Interpreter::evaluate_field_default(std::string identifier,
-                                    EvaluationContext context,
-                                    std::shared_ptr<EvaluationState> state,
-                                    std::optional<IValue> default_value) {
-  std::optional<Field> field = find_field(identifier, context.task_scope);
+IValue Interpreter::evaluate_field_default(std::string const &identifier,
+                                           EvaluationContext const &context,
+                                           EvaluationState &state,
+                                           std::optional<IValue> default_value) {
+  IRField const *field = m_program.find_field(identifier, context.task_scope);
   if (!field) {
     if (!default_value) {
       ErrorHandler::push_error_throw(ObjectReference(identifier),
@@ -520,47 +592,65 @@ Interpreter::evaluate_field_default(std::string identifier,
     }
     return *default_value;
   }
-  return evaluate_ast_object(field->expression, m_ast, context, state);
+  return evaluate_field(*field, context, state);
 }
 
 std::optional<IValue>
-Interpreter::evaluate_field_optional(std::string identifier,
-                                     EvaluationContext context,
-                                     std::shared_ptr<EvaluationState> state) {
-  std::optional<Field> field = find_field(identifier, context.task_scope);
+Interpreter::evaluate_field_optional(std::string const &identifier,
+                                     EvaluationContext const &context,
+                                     EvaluationState &state) {
+  IRField const *field = m_program.find_field(identifier, context.task_scope);
   if (!field)
     return std::nullopt;
-  return evaluate_ast_object(field->expression, m_ast, context, state);
+  return evaluate_field(*field, context, state);
 }
 
-void Interpreter::t_run_task(Task task, std::string task_iteration,
+// how long the commands of a task iteration are expected to take.
+uint64_t Interpreter::estimate(PathId task_iteration) const {
+  return m_history ? m_history->estimate(task_iteration) : 0;
+}
+
+void Interpreter::t_run_task(IRTask const *task, PathId task_iteration,
+                             uint64_t critical_path,
                              std::shared_ptr<std::atomic<bool>> error) {
   try {
-    if (0 > run_task(task, task_iteration))
+    if (0 > run_task(*task, task_iteration, critical_path))
       *error = true;
   } catch (...) {
     // it's ok to ignore the exception, since the task failure will throw an
     // I_DEPENDENCY_FAILED regardless, which will unwind the combined error
-    // stack.
+    // stack. the rest of the build is cancelled like for a failed command.
     *error = true;
+    Jobs::fail();
+  }
+}
+
+// dependencies are stat'ed once they have been built, and the newest one is
+// kept so that rebuilds can be explained.
+static void stat_dependency(DependencyStatus &status, PathId dependency) {
+  std::optional<size_t> modified = dependency.timestamp();
+  if (modified && (!status.modified || *status.modified < *modified)) {
+    status.modified = modified;
+    status.newest = dependency;
   }
 }
 
 DependencyStatus
-Interpreter::_solve_dependencies_parallel(IValue dependencies) {
+Interpreter::_solve_dependencies_parallel(IValue const &dependencies,
+                                          uint64_t critical_path) {
+  DependencyStatus status = {true, std::nullopt, {}};
   if (std::holds_alternative<IString>(dependencies.value)) {
     // only one dependency - no reason to use a separate thread.
-    IString task_iteration = std::get<IString>(dependencies.value);
-    std::optional<Task> _task = find_task(task_iteration);
-    std::optional<size_t> modified =
-        OSLayer::get_file_timestamp(task_iteration.toString());
-    if (!_task) {
-      return {true, modified};
+    PathId task_iteration(std::get<IString>(dependencies.value).view());
+    IRTask const *_task = find_task(task_iteration);
+    if (_task) {
+      int run_status = run_task(*_task, task_iteration, critical_path);
+      if (0 > run_status)
+        ErrorHandler::push_error(_task->origin, I_DEPENDENCY_FAILED);
+      status.success = 0 == run_status;
     }
-    int run_status = run_task(*_task, task_iteration.toString());
-    if (0 > run_status)
-      ErrorHandler::push_error(_task->origin, I_DEPENDENCY_FAILED);
-    return {0 == run_status, modified};
+    stat_dependency(status, task_iteration);
+    return status;
   }
   if (!std::holds_alternative<IList>(dependencies.value) ||
       !std::get<IList>(dependencies.value).holds_qbstring()) {
@@ -570,71 +660,84 @@ Interpreter::_solve_dependencies_parallel(IValue dependencies) {
   }
 
   std::vector<std::thread> pool;
-  IList dependencies_list = std::get<IList>(dependencies.value);
   std::shared_ptr<std::atomic<bool>> error =
       std::make_shared<std::atomic<bool>>();
   *error = false;
-  std::optional<size_t> modified;
-
-  for (IString task_iteration :
-       std::get<QBLIST_STR>(std::get<IList>(dependencies.value).contents)) {
-    std::optional<Task> _task = find_task(task_iteration);
-    std::optional<size_t> modified_i =
-        OSLayer::get_file_timestamp(task_iteration.toString());
-    if (!modified || (modified_i && modified < modified_i))
-      modified = modified_i;
-    if (!_task) {
-      continue;
-    }
-    pool.push_back(std::thread(&Interpreter::t_run_task, this, *_task,
-                               task_iteration.toString(), error));
+
+  std::vector<PathId> iterations =
+      intern_paths(std::get<IList>(dependencies.value).strings());
+  std::vector<IRTask const *> tasks = find_tasks(iterations);
+  // the dependencies that are expected to take the longest start first.
+  std::vector<size_t> order;
+  for (size_t i = 0; i < iterations.size(); i++) {
+    if (tasks[i])
+      order.push_back(i);
+  }
+  if (m_history) {
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return estimate(iterations[a]) > estimate(iterations[b]);
+    });
+  }
+  for (size_t i : order) {
+    Stats::add(Counter::ThreadsSpawned);
+    pool.push_back(std::thread(&Interpreter::t_run_task, this, tasks[i],
+                               iterations[i], critical_path, error));
   }
 
   for (std::thread &thread : pool) {
     thread.join();
   }
 
+  // the dependencies are stat'ed in one go, once all of them are built.
+  TraceSpan stat_span("stat dependencies");
+  for (PathId task_iteration : iterations)
+    stat_dependency(status, task_iteration);
+  stat_span.end();
+
   if (*error) {
     ErrorHandler::push_error(InternalNode{}, I_DEPENDENCY_FAILED);
-    return {false, modified};
-  } else
-    return {true, modified};
+    status.success = false;
+  }
+  return status;
 }
 
-DependencyStatus Interpreter::_solve_dependencies_sync(IValue dependencies) {
+DependencyStatus
+Interpreter::_solve_dependencies_sync(IValue const &dependencies,
+                                      uint64_t critical_path) {
+  DependencyStatus status = {true, std::nullopt, {}};
   if (std::holds_alternative<IString>(dependencies.value)) {
-    IString task_iteration = std::get<IString>(dependencies.value);
-    std::optional<Task> _task = find_task(task_iteration);
-    std::optional<size_t> modified =
-        OSLayer::get_file_timestamp(task_iteration.toString());
+    PathId task_iteration(std::get<IString>(dependencies.value).view());
+    IRTask const *_task = find_task(task_iteration);
     if (_task) {
-      int run_status = run_task(*_task, task_iteration.toString());
+      int run_status = run_task(*_task, task_iteration, critical_path);
       if (0 > run_status)
         ErrorHandler::push_error(_task->origin, I_DEPENDENCY_FAILED);
-      return {0 == run_status, modified};
+      status.success = 0 == run_status;
     }
-    return {true, modified};
+    stat_dependency(status, task_iteration);
+    return status;
   } else if (std::holds_alternative<IList>(dependencies.value) &&
              std::get<IList>(dependencies.value).holds_qbstring()) {
-    std::optional<size_t> modified;
-    for (IString task_iteration :
-         std::get<QBLIST_STR>(std::get<IList>(dependencies.value).contents)) {
-      std::optional<Task> _task = find_task(task_iteration);
-      std::optional<size_t> modified_i =
-          OSLayer::get_file_timestamp(task_iteration.toString());
-      if (!modified || (modified_i && modified < modified_i))
-        modified = modified_i;
-      if (!_task) {
-        continue;
-      }
-      int run_status = run_task(*_task, task_iteration.toString());
-      if (0 > run_status)
-        ErrorHandler::push_error(_task->origin, I_DEPENDENCY_FAILED);
-      if (0 > run_status) {
-        return {false, modified};
+    std::vector<PathId> iterations =
+        intern_paths(std::get<IList>(dependencies.value).strings());
+    std::vector<IRTask const *> tasks = find_tasks(iterations);
+    for (size_t i = 0; i < iterations.size(); i++) {
+      PathId task_iteration = iterations[i];
+      IRTask const *_task = tasks[i];
+      if (_task) {
+        int run_status = run_task(*_task, task_iteration, critical_path);
+        if (0 > run_status) {
+          ErrorHandler::push_error(_task->origin, I_DEPENDENCY_FAILED);
+          status.success = false;
+          // the remaining dependencies don't depend on this one.
+          if (!m_setup.keep_going)
+            return status;
+          continue;
+        }
       }
+      stat_dependency(status, task_iteration);
     }
-    return {true, modified};
+    return status;
   } else {
     ErrorHandler::push_error_throw(
         std::visit(QBVisitOrigin{}, dependencies.value), I_TYPE_DEPENDENCIES);
@@ -642,52 +745,129 @@ DependencyStatus Interpreter::_solve_dependencies_sync(IValue dependencies) {
   }
 }
 
-DependencyStatus Interpreter::solve_dependencies(IValue dependencies,
-                                                 bool parallel) {
+DependencyStatus Interpreter::solve_dependencies(IValue const &dependencies,
+                                                 bool parallel,
+                                                 uint64_t critical_path) {
   if (parallel)
-    return _solve_dependencies_parallel(dependencies);
+    return _solve_dependencies_parallel(dependencies, critical_path);
+  else
+    return _solve_dependencies_sync(dependencies, critical_path);
+}
+
+static std::string format_timestamp(size_t timestamp) {
+  std::time_t time = (std::time_t)timestamp;
+  std::tm local;
+  char buffer[32];
+  if (!localtime_r(&time, &local) ||
+      !std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &local))
+    return std::to_string(timestamp);
+  return buffer;
+}
+
+// only called with `--explain`, once it's known that the task will run.
+void Interpreter::explain_task(PathId task_iteration, bool has_dependencies,
+                               std::optional<size_t> modified,
+                               std::optional<size_t> dep_modified,
+                               PathId dep_newest) {
+  if (!has_dependencies) {
+    LOG_STANDARD("  " << ITALIC << "?" << RESET << " "
+                      << task_iteration.view() << ": has no dependencies");
+  } else if (!dep_modified) {
+    LOG_STANDARD("  " << ITALIC << "?" << RESET << " "
+                      << task_iteration.view()
+                      << ": is phony, none of its dependencies are files");
+  } else if (!modified) {
+    LOG_STANDARD("  " << ITALIC << "?" << RESET << " "
+                      << task_iteration.view() << ": output is missing");
+  } else {
+    LOG_STANDARD("  " << ITALIC << "?" << RESET << " "
+                      << task_iteration.view() << ": " << dep_newest.view()
+                      << " (" << format_timestamp(*dep_modified)
+                      << ") is newer than the output ("
+                      << format_timestamp(*modified) << ")");
+  }
+}
+
+// the commands of a task are expected to have written its file, and the
+// outputs it declares. the cached timestamps of those are invalidated, or
+// of every path if the task has side effects, i.e. may write any file.
+static void invalidate_outputs(PathId task_iteration,
+                               std::optional<IValue> const &outputs,
+                               bool side_effects) {
+  if (side_effects) {
+    PathId::invalidate_all();
+    return;
+  }
+  task_iteration.invalidate();
+  if (!outputs)
+    return;
+  // note: paths that were never interned have never been stat'ed either.
+  auto invalidate = [](std::string_view output) {
+    if (std::optional<PathId> path = PathId::find(output))
+      path->invalidate();
+  };
+  if (std::holds_alternative<IString>(outputs->value))
+    invalidate(std::get<IString>(outputs->value).view());
   else
-    return _solve_dependencies_sync(dependencies);
+    for (std::string_view output :
+         std::get<IList>(outputs->value).strings().contents)
+      invalidate(output);
 }
 
-int Interpreter::run_task(Task task, std::string task_iteration) {
+// the critical path is how long the build is expected to take once the task
+// has finished. its dependencies are on a path that is this task longer,
+// which decides which of their commands get a job slot first.
+int Interpreter::run_task(IRTask const &task, PathId task_iteration,
+                          uint64_t critical_path) {
+  // once the build has been cancelled, tasks that haven't started yet are
+  // skipped.
+  if (Jobs::cancelled())
+    return -1;
+  TraceSpan span("task", task_iteration.view());
+  critical_path += estimate(task_iteration);
+  EvaluationContext context = {&task, task_iteration};
+
   // solve dependencies.
   std::optional<IValue> dependencies =
-      evaluate_field_optional(DEPENDS, {task, task_iteration}, this->state);
+      evaluate_field_optional(DEPENDS, context, *this->state);
   std::optional<size_t> dep_modified;
+  PathId dep_newest;
   if (dependencies) {
     IValue parallel_default = {IBool(false, InternalNode{}), true};
-    IValue parallel =
-        evaluate_field_default(DEPENDS_PARALLEL, {task, task_iteration},
-                               this->state, parallel_default);
+    IValue parallel = evaluate_field_default(DEPENDS_PARALLEL, context,
+                                             *this->state, parallel_default);
     if (!std::holds_alternative<IBool>(parallel.value)) {
       ErrorHandler::push_error_throw(
           std::visit(QBVisitOrigin{}, parallel.value), I_TYPE_PARALLEL);
     }
+    TraceSpan dependency_span("dependencies", task_iteration.view());
     DependencyStatus dep_stat =
-        solve_dependencies(*dependencies, std::get<IBool>(parallel.value));
+        solve_dependencies(*dependencies, std::get<IBool>(parallel.value),
+                           critical_path);
+    dependency_span.end();
     dep_modified = dep_stat.modified;
+    dep_newest = dep_stat.newest;
     if (!dep_stat.success)
       return -1;
   }
 
   // check for changes.
-  std::optional<size_t> this_modified =
-      OSLayer::get_file_timestamp(task_iteration);
+  std::optional<size_t> this_modified = task_iteration.timestamp();
   if (this_modified && dep_modified && *this_modified >= *dep_modified) {
-    LOG_STANDARD("  " << "•" << RESET << " skipped " << task_iteration);
+    LOG_STANDARD("  " << "•" << RESET << " skipped "
+                      << task_iteration.view());
     return 0;
   }
 
   // execution related fields.
   std::optional<IValue> command_expr =
-      evaluate_field_optional(RUN, {task, task_iteration}, this->state);
+      evaluate_field_optional(RUN, context, *this->state);
   if (!command_expr) {
     return 0; // abstract task.
   }
   IValue run_parallel_default = {IBool(false, InternalNode{}), true};
   IValue run_parallel = evaluate_field_default(
-      RUN_PARALLEL, {task, task_iteration}, this->state, run_parallel_default);
+      RUN_PARALLEL, context, *this->state, run_parallel_default);
   if (!std::holds_alternative<IBool>(run_parallel.value)) {
     ErrorHandler::push_error_throw(
         std::visit(QBVisitOrigin{}, run_parallel.value), I_TYPE_PARALLEL);
@@ -698,77 +878,129 @@ int Interpreter::run_task(Task task, std::string task_iteration) {
     ErrorHandler::push_error_throw(
         std::visit(QBVisitOrigin{}, command_expr->value), I_TYPE_RUN);
   }
+  std::optional<IValue> outputs =
+      evaluate_field_optional(OUTPUTS, context, *this->state);
+  if (outputs && !std::holds_alternative<IString>(outputs->value) &&
+      !(std::holds_alternative<IList>(outputs->value) &&
+        std::get<IList>(outputs->value).holds_qbstring())) {
+    ErrorHandler::push_error_throw(
+        std::visit(QBVisitOrigin{}, outputs->value), I_TYPE_OUTPUTS);
+  }
+  IValue side_effects_default = {IBool(false, InternalNode{}), true};
+  IValue side_effects = evaluate_field_default(
+      SIDE_EFFECTS, context, *this->state, side_effects_default);
+  if (!std::holds_alternative<IBool>(side_effects.value)) {
+    ErrorHandler::push_error_throw(
+        std::visit(QBVisitOrigin{}, side_effects.value), I_TYPE_SIDE_EFFECTS);
+  }
+  IValue response_files_default = {IBool(false, InternalNode{}), true};
+  IValue response_files = evaluate_field_default(
+      RESPONSE_FILES, context, *this->state, response_files_default);
+  if (!std::holds_alternative<IBool>(response_files.value)) {
+    ErrorHandler::push_error_throw(
+        std::visit(QBVisitOrigin{}, response_files.value),
+        I_TYPE_RESPONSE_FILES);
+  }
+
+  if (m_setup.explain) {
+    explain_task(task_iteration, dependencies.has_value(), this_modified,
+                 dep_modified, dep_newest);
+  }
 
   // execute task.
-  LOG_STANDARD("  " << CYAN << "»" << RESET << " starting " << task_iteration);
+  LOG_STANDARD("  " << CYAN << "»" << RESET << " starting "
+                    << task_iteration.view());
   if (std::holds_alternative<IString>(command_expr->value)) {
     // single command
-    IString cmdline = std::get<IString>(command_expr->value);
-    OSLayer os_layer(std::get<IBool>(run_parallel.value), false);
-    os_layer.queue_command({cmdline.toString(), cmdline.origin});
+    IString const &cmdline = std::get<IString>(command_expr->value);
+    OSLayer os_layer(std::get<IBool>(run_parallel.value), false,
+                     critical_path, std::get<IBool>(response_files.value));
+    os_layer.queue_command(
+        {cmdline.toString(), cmdline.origin,
+         cmdline.expansions ? *cmdline.expansions
+                            : std::vector<IExpansion>()});
     os_layer.execute_queue();
+    if (m_report && !os_layer.was_cancelled())
+      m_report->add_task(task_iteration, os_layer.get_usage());
+    if (m_history && !os_layer.was_cancelled())
+      m_history->record(task_iteration, os_layer.get_usage().wall);
+    invalidate_outputs(task_iteration, outputs,
+                       std::get<IBool>(side_effects.value).content);
     if (!os_layer.get_errors().empty()) {
       for (ErrorContext const &e_ctx : os_layer.get_errors()) {
         ErrorHandler::push_error(e_ctx, I_NONZERO_PROCESS);
       }
       return -1;
     }
+    if (os_layer.was_cancelled())
+      return -1;
   } else if (std::holds_alternative<IList>(command_expr->value) &&
              std::get<IList>(command_expr->value).holds_qbstring()) {
     // multiple commands
-    OSLayer os_layer(std::get<IBool>(run_parallel.value), false);
-    for (IString cmdline :
-         std::get<QBLIST_STR>(std::get<IList>(command_expr->value).contents)) {
-      os_layer.queue_command({cmdline.toString(), cmdline.origin});
+    OSLayer os_layer(std::get<IBool>(run_parallel.value), false,
+                     critical_path, std::get<IBool>(response_files.value));
+    for (IString const &cmdline :
+         std::get<IList>(command_expr->value).strings()) {
+      os_layer.queue_command(
+          {cmdline.toString(), cmdline.origin,
+           cmdline.expansions ? *cmdline.expansions
+                              : std::vector<IExpansion>()});
     }
     os_layer.execute_queue();
+    if (m_report && !os_layer.was_cancelled())
+      m_report->add_task(task_iteration, os_layer.get_usage());
+    if (m_history && !os_layer.was_cancelled())
+      m_history->record(task_iteration, os_layer.get_usage().wall);
+    invalidate_outputs(task_iteration, outputs,
+                       std::get<IBool>(side_effects.value).content);
     if (!os_layer.get_errors().empty()) {
       for (ErrorContext const &e_ctx : os_layer.get_errors()) {
         ErrorHandler::push_error(e_ctx, I_NONZERO_PROCESS);
       }
       return -1;
     }
+    if (os_layer.was_cancelled())
+      return -1;
   }
 
-  LOG_STANDARD("  " << GREEN << "✓" << RESET << " finished " << task_iteration);
+  LOG_STANDARD("  " << GREEN << "✓" << RESET << " finished "
+                    << task_iteration.view());
   return 0;
 }
 
-int Interpreter::build() {
-
-  this->state = std::make_shared<EvaluationState>();
+IValue Interpreter::evaluate_global(std::string const &identifier) {
+  return evaluate_field_default(identifier, {}, *state, std::nullopt);
+}
 
+int Interpreter::build() {
   // find the task.
-  if (m_ast.tasks.empty())
+  if (m_program.tasks.empty())
     ErrorHandler::push_error_throw(InternalNode{}, I_NO_TASKS);
-  std::optional<Task> task;
-  std::string task_iteration;
+  IRTask const *task = nullptr;
+  PathId task_iteration;
   if (m_setup.task) {
-    task = find_task(IString(*m_setup.task, InternalNode{}));
-    task_iteration = *m_setup.task;
+    task_iteration = PathId(*m_setup.task);
+    task = find_task(task_iteration);
     if (!task) {
       ErrorHandler::push_error_throw(ObjectReference(*m_setup.task),
                                      I_SPECIFIED_TASK_NOT_FOUND);
     }
-  } else if (m_ast.tasks.size() > 0) {
-    task = m_ast.tasks[0];
-    IValue task_iteration_qbvalue = evaluate_ast_object(
-        m_ast.tasks[0].identifier, m_ast, {std::nullopt, std::nullopt}, state);
+  } else if (m_program.tasks.size() > 0) {
+    task = &m_program.tasks[0];
+    IValue task_iteration_qbvalue =
+        evaluate_expression(task->identifier, {}, *state);
     if (!std::holds_alternative<IString>(task_iteration_qbvalue.value)) {
       ErrorHandler::push_error_throw(
           std::visit(QBVisitOrigin{}, task_iteration_qbvalue.value),
           I_MULTIPLE_TASKS);
     }
-    task_iteration = std::get<IString>(evaluate_ast_object(
-                                           m_ast.tasks[0].identifier, m_ast,
-                                           {std::nullopt, std::nullopt}, state)
-                                           .value)
-                         .toString();
+    task_iteration =
+        PathId(std::get<IString>(task_iteration_qbvalue.value).view());
   } else {
     ErrorHandler::push_error_throw(InternalNode{}, I_NO_TASKS);
   }
 
-  LOG_STANDARD("⧗ building " << CYAN << task_iteration << RESET);
+  LOG_STANDARD("⧗ building " << CYAN << task_iteration.view() << RESET);
   // todo: error checking is also required here in case task doesn't exist.
   if (0 == run_task(*task, task_iteration)) {
     return 0;
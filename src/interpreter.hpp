@@ -1,103 +1,113 @@
 #ifndef INTERPRETER_H
 #define INTERPRETER_H
 
+#include "compiler.hpp"
 #include "driver.hpp"
+#include "history.hpp"
 #include "parser.hpp"
+#include "paths.hpp"
+#include "report.hpp"
+#include "values.hpp"
+#include <memory>
 #include <mutex>
+#include <string_view>
+#include <unordered_map>
 #include <variant>
 #include <vector>
 
-struct IString {
-  Origin origin;
-  std::string content;
-
-  std::string toString() const;
-  IString();
-  IString(Token);
-  IString(std::string, Origin);
-  bool operator==(IString const other) const;
-};
-
-struct IBool {
-  Origin origin;
-  bool content;
-  IBool();
-  IBool(Token);
-  IBool(bool, Origin);
-  operator bool() const;
-  bool operator==(IBool const other) const;
-};
-
-#define QBLIST_STR 0
-#define QBLIST_BOOL 1
-
-struct IList {
-  Origin origin;
-  std::variant<std::vector<IString>, std::vector<IBool>> contents;
-  bool holds_qbstring() const;
-  bool holds_qbbool() const;
-  IList();
-  IList(std::variant<std::vector<IString>, std::vector<IBool>>);
-  bool operator==(IList const other) const;
-};
-
-struct IValue {
-  std::variant<IString, IBool, IList> value;
-  bool immutable = true;
-};
-
 struct EvaluationContext {
-  std::optional<Task> task_scope;
-  std::optional<std::string> task_iteration;
+  IRTask const *task_scope = nullptr;
+  std::optional<PathId> task_iteration;
   bool use_globbing = true;
-  bool context_verify(EvaluationContext const) const;
 };
 
-struct ValueInstance {
-  Identifier identifier;
-  EvaluationContext context;
-  IValue result;
+// identifies the value of a field for a single iteration of a task.
+struct IterationKey {
+  uint32_t slot;
+  PathId iteration;
+  bool operator==(IterationKey const &other) const {
+    return slot == other.slot && iteration == other.iteration;
+  }
+};
+
+struct IterationKeyHash {
+  size_t operator()(IterationKey const &key) const {
+    return (uint64_t(key.slot) << 32 | key.iteration.id) * 0x9e3779b97f4a7c15;
+  }
 };
 
 struct EvaluationState {
-  std::vector<ValueInstance> values;
+  // immutable field values, indexed by `field id * 2 + use_globbing`.
+  std::vector<std::optional<IValue>> values;
+  // values that depend on the iteration, kept for the entire build.
+  std::unordered_map<IterationKey, IValue, IterationKeyHash> iteration_values;
+  std::vector<IValue> stack;
+  std::vector<size_t> replace_matches; // reused by every replacement.
+  Arena &arena;
+  EvaluationState(Arena &arena) : arena(arena) {}
 };
 
 struct DependencyStatus {
   bool success;
-  std::optional<size_t> modified;
+  std::optional<size_t> modified; // of the newest dependency.
+  PathId newest;
 };
 
 class Interpreter {
 private:
-  AST &m_ast;
+  IRProgram const &m_program;
   Setup m_setup;
-  std::shared_ptr<EvaluationState> state;
+  Arena &m_arena;
+  BuildReport *m_report;
+  BuildHistory *m_history;
+  std::unique_ptr<EvaluationState> state;
   std::mutex evaluation_lock;
+  // the task of every path, indexed by its id. built on first use.
+  std::vector<IRTask const *> m_task_index;
+  bool m_task_index_built = false;
 
-  IValue evaluate_ast_object(ASTObject ast_object, AST &ast,
-                             EvaluationContext context,
-                             std::shared_ptr<EvaluationState> state);
-  std::optional<Task> find_task(IString identifier);
-  std::optional<Field> find_field(std::string identifier,
-                                  std::optional<Task> task);
+  std::unique_lock<std::mutex> lock_evaluation();
+  IValue evaluate_expression(uint32_t expression,
+                             EvaluationContext const &context,
+                             EvaluationState &state);
+  IValue evaluate_field(IRField const &field, EvaluationContext const &context,
+                        EvaluationState &state);
+  void build_task_index();
+  std::vector<IRTask const *> find_tasks(std::vector<PathId> const &identifiers);
   std::optional<IValue>
-  evaluate_field_optional(std::string identifier, EvaluationContext context,
-                          std::shared_ptr<EvaluationState> state);
-  IValue evaluate_field_default(std::string identifier,
-                                EvaluationContext context,
-                                std::shared_ptr<EvaluationState> state,
+  evaluate_field_optional(std::string const &identifier,
+                          EvaluationContext const &context,
+                          EvaluationState &state);
+  IValue evaluate_field_default(std::string const &identifier,
+                                EvaluationContext const &context,
+                                EvaluationState &state,
                                 std::optional<IValue> default_value);
-  void t_run_task(Task task, std::string task_iteration,
+  uint64_t estimate(PathId task_iteration) const;
+  void t_run_task(IRTask const *task, PathId task_iteration,
+                  uint64_t critical_path,
                   std::shared_ptr<std::atomic<bool>> error);
-  int run_task(Task task, std::string task_iteration);
-  DependencyStatus _solve_dependencies_parallel(IValue dependencies);
-  DependencyStatus _solve_dependencies_sync(IValue dependencies);
-  DependencyStatus solve_dependencies(IValue dependencies, bool parallel);
+  int run_task(IRTask const &task, PathId task_iteration,
+               uint64_t critical_path = 0);
+  void explain_task(PathId task_iteration, bool has_dependencies,
+                    std::optional<size_t> modified,
+                    std::optional<size_t> dep_modified, PathId dep_newest);
+  DependencyStatus _solve_dependencies_parallel(IValue const &dependencies,
+                                               uint64_t critical_path);
+  DependencyStatus _solve_dependencies_sync(IValue const &dependencies,
+                                           uint64_t critical_path);
+  DependencyStatus solve_dependencies(IValue const &dependencies,
+                                      bool parallel, uint64_t critical_path);
 
 public:
-  Interpreter(AST &ast, Setup setup);
+  Interpreter(IRProgram const &program, Setup setup, Arena &arena,
+              BuildReport *report = nullptr, BuildHistory *history = nullptr);
   int build();
+  IRTask const *find_task(PathId identifier);
+  // evaluates a global field on its own, e.g. for benchmarks.
+  IValue evaluate_global(std::string const &identifier);
 };
 
+IValue expand_literal(IString const &input_qbstring, bool immutable,
+                      Arena &arena);
+
 #endif
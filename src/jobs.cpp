@@ -0,0 +1,172 @@
+#include "jobs.hpp"
+#include "log.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <csignal>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef WIN32
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+size_t Jobs::s_limit = 0;
+bool Jobs::s_keep_going = false;
+std::atomic<bool> Jobs::s_cancelled = false;
+
+// every waiter has its own condition, so that a freed slot only wakes the
+// thread it's handed to.
+struct JobWaiter {
+  uint64_t priority;
+  uint64_t ticket; // waiters of equal priority are served in order.
+  bool woken = false;
+  bool granted = false; // not granted if the build was cancelled.
+  std::condition_variable condition;
+
+  JobWaiter(uint64_t priority, uint64_t ticket)
+      : priority(priority), ticket(ticket) {}
+};
+
+static std::mutex jobs_lock;
+static size_t available = 0;
+static uint64_t tickets = 0;
+static std::vector<JobWaiter *> waiters; // a heap, see `waits_longer`.
+static std::vector<int> running;
+
+static bool waits_longer(JobWaiter const *a, JobWaiter const *b) {
+  if (a->priority != b->priority)
+    return a->priority < b->priority;
+  return a->ticket > b->ticket;
+}
+
+void Jobs::set_limit(size_t limit) {
+  std::lock_guard<std::mutex> lock(jobs_lock);
+  s_limit = limit;
+  available = limit;
+}
+
+void Jobs::set_keep_going(bool keep_going) { s_keep_going = keep_going; }
+
+bool Jobs::acquire(uint64_t priority) {
+  if (0 == s_limit)
+    return !s_cancelled;
+  std::unique_lock<std::mutex> lock(jobs_lock);
+  if (s_cancelled)
+    return false;
+  if (available > 0 && waiters.empty()) {
+    available--;
+    return true;
+  }
+  TraceSpan span("wait for job", {}, TRACE_MIN_WAIT_NS);
+  JobWaiter waiter(priority, tickets++);
+  waiters.push_back(&waiter);
+  std::push_heap(waiters.begin(), waiters.end(), waits_longer);
+  waiter.condition.wait(lock, [&waiter]() { return waiter.woken; });
+  return waiter.granted;
+}
+
+// note: the waiter is notified while the lock is still held, since it's
+// gone as soon as it sees that it has been woken.
+void Jobs::release() {
+  if (0 == s_limit)
+    return;
+  std::lock_guard<std::mutex> lock(jobs_lock);
+  if (waiters.empty()) {
+    available++;
+    return;
+  }
+  std::pop_heap(waiters.begin(), waiters.end(), waits_longer);
+  JobWaiter *waiter = waiters.back();
+  waiters.pop_back();
+  waiter->woken = true;
+  waiter->granted = true;
+  waiter->condition.notify_one();
+}
+
+// commands that would be stopped for reading from the terminal have to
+// stay in its foreground process group, i.e. the one of quickbuild.
+bool Jobs::process_groups() {
+#ifndef WIN32
+  static bool const process_groups = !isatty(STDIN_FILENO);
+  return process_groups;
+#else
+  return false;
+#endif
+}
+
+// a command in its own process group is signalled as a whole, so that the
+// processes started by the shell are terminated too.
+static void signal_command(int pid, int number) {
+#ifndef WIN32
+  kill(Jobs::process_groups() ? -pid : pid, number);
+#else
+  (void)pid;
+  (void)number;
+#endif
+}
+
+// wakes every waiter and sends the signal to every running command.
+// note: has to be called with the lock held.
+static void cancel_locked(int number) {
+  for (JobWaiter *waiter : waiters) {
+    waiter->woken = true;
+    waiter->condition.notify_one();
+  }
+  waiters.clear();
+  for (int pid : running)
+    signal_command(pid, number);
+}
+
+void Jobs::fail() {
+  if (s_keep_going)
+    return;
+  std::lock_guard<std::mutex> lock(jobs_lock);
+  if (!s_cancelled.exchange(true))
+    cancel_locked(SIGTERM);
+}
+
+// commands in their own process group don't see e.g. a ctrl-c themselves.
+// it's forwarded to them before quickbuild terminates, from a thread that
+// waits for the signals that are blocked.
+void Jobs::forward_signals() {
+#ifndef WIN32
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  sigaddset(&signals, SIGHUP);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+  std::thread([signals]() {
+    int number;
+    while (0 != sigwait(&signals, &number))
+      ;
+    std::lock_guard<std::mutex> lock(jobs_lock);
+    s_cancelled = true;
+    cancel_locked(number);
+    Log::flush();
+    signal(number, SIG_DFL);
+    pthread_sigmask(SIG_UNBLOCK, &signals, nullptr);
+    raise(number);
+  }).detach();
+#endif
+}
+
+// a command that is started while the build is being cancelled is
+// terminated right away.
+void Jobs::track(int pid) {
+  std::lock_guard<std::mutex> lock(jobs_lock);
+  running.push_back(pid);
+#ifndef WIN32
+  if (s_cancelled)
+    signal_command(pid, SIGTERM);
+#endif
+}
+
+void Jobs::untrack(int pid) {
+  std::lock_guard<std::mutex> lock(jobs_lock);
+  running.erase(std::find(running.begin(), running.end(), pid));
+}
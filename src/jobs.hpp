@@ -0,0 +1,61 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// limits how many commands run at once (`-j`). when every slot is taken,
+// a freed slot goes to the waiting command with the highest priority, i.e.
+// the one with the longest estimated path to the end of the build.
+// note: commands aren't limited unless a limit is set before the build.
+//
+// unless the build keeps going (`-k`), the first command that fails cancels
+// the build: commands that are running are terminated, and no more are
+// started. the same happens when quickbuild is interrupted.
+class Jobs {
+private:
+  static size_t s_limit;
+  static bool s_keep_going;
+  static std::atomic<bool> s_cancelled;
+
+public:
+  static void set_limit(size_t limit);
+  static size_t limit() { return s_limit; }
+  static void set_keep_going(bool keep_going);
+  static bool cancelled() { return s_cancelled; }
+  // returns false if the build was cancelled instead.
+  static bool acquire(uint64_t priority);
+  static void release();
+  // cancels the build, unless it keeps going.
+  static void fail();
+  // has to be called before any other thread is started.
+  static void forward_signals();
+  // whether every command runs in its own process group, which is only the
+  // case if stdin isn't a terminal.
+  static bool process_groups();
+  // commands are tracked while they run, so that they can be terminated.
+  // note: a command has to be untracked before it's reaped, since its pid
+  // may be reused afterwards.
+  static void track(int pid);
+  static void untrack(int pid);
+};
+
+// holds a job slot for its lifetime.
+class JobSlot {
+private:
+  bool m_acquired;
+
+public:
+  JobSlot(uint64_t priority) : m_acquired(Jobs::acquire(priority)) {}
+  ~JobSlot() {
+    if (m_acquired)
+      Jobs::release();
+  }
+  JobSlot(JobSlot const &) = delete;
+  JobSlot &operator=(JobSlot const &) = delete;
+  // false if the build was cancelled while waiting for the slot.
+  bool acquired() const { return m_acquired; }
+};
+
+#endif
@@ -1,213 +1,221 @@
 #include "lexer.hpp"
 #include "errors.hpp"
-#include <functional>
+#include <array>
+#include <cstring>
 #include <variant>
 
+// character classes, used for dispatching on the first byte of a token.
+enum CharClass : unsigned char {
+  C_INVALID,
+  C_WHITESPACE,
+  C_COMMENT,
+  C_SYMBOL,
+  C_DASH, // either an arrow or an identifier.
+  C_QUOTE,
+  C_IDENTIFIER,
+};
+
+static constexpr std::array<unsigned char, 256> CHAR_CLASSES = [] {
+  std::array<unsigned char, 256> table = {};
+  for (unsigned char c = 'A'; c <= 'Z'; c++)
+    table[c] = C_IDENTIFIER;
+  for (unsigned char c = 'a'; c <= 'z'; c++)
+    table[c] = C_IDENTIFIER;
+  for (unsigned char c = '0'; c <= '9'; c++)
+    table[c] = C_IDENTIFIER;
+  table['_'] = C_IDENTIFIER;
+  table['-'] = C_DASH;
+  table[' '] = table['\n'] = table['\t'] = C_WHITESPACE;
+  table['#'] = C_COMMENT;
+  table['"'] = C_QUOTE;
+  for (unsigned char c : {'=', ':', ';', ',', '[', ']', '{', '}'})
+    table[c] = C_SYMBOL;
+  return table;
+}();
+
+static constexpr std::array<TokenType, 256> SYMBOL_TYPES = [] {
+  std::array<TokenType, 256> table = {};
+  for (TokenType &type : table)
+    type = TokenType::Invalid;
+  table['='] = TokenType::Equals;
+  table[':'] = TokenType::Modify;
+  table[';'] = TokenType::LineStop;
+  table[','] = TokenType::Separator;
+  table['['] = TokenType::ExpressionOpen;
+  table[']'] = TokenType::ExpressionClose;
+  table['{'] = TokenType::TaskOpen;
+  table['}'] = TokenType::TaskClose;
+  return table;
+}();
+
 // used for determining e.g. variable names.
-inline bool is_alphabetic(char x) {
-  return ((x >= 'A') && (x <= 'Z')) || ((x >= 'a') && (x <= 'z')) || x == '_' ||
-         x == '-' || (x >= '0' && x <= '9');
+inline bool is_alphabetic(unsigned char x) {
+  return CHAR_CLASSES[x] == C_IDENTIFIER || CHAR_CLASSES[x] == C_DASH;
 }
 
 // initializes new lexer.
-Lexer::Lexer(std::vector<unsigned char> input_bytes) {
+Lexer::Lexer(std::string_view input, uint32_t file) {
+  m_input = input;
+  m_file = file;
   m_index = 0;
-  _m_line = 1;
-  m_input = input_bytes;
-  m_current = (m_input.size() >= m_index + 1) ? m_input[m_index] : '\0';
-  m_next = (m_input.size() >= m_index + 2) ? m_input[m_index + 1] : '\0';
+  m_line = 1;
+  m_line_index = 1;
 }
 
-unsigned char Lexer::consume_byte() { return consume_byte(1); }
+// returns the byte at an offset from the current index, or `\0` at the end.
+unsigned char Lexer::peek(size_t offset) const {
+  return (m_index + offset < m_input.size()) ? m_input[m_index + offset]
+                                             : '\0';
+}
 
-unsigned char Lexer::consume_byte(int n) {
-  size_t original_index = m_index;
-  // loop to scan for newlines.
-  for (; m_index < original_index + n;) {
-    m_index++;
-    m_current = (m_input.size() >= m_index + 1) ? m_input[m_index] : '\0';
-    m_next = (m_input.size() >= m_index + 2) ? m_input[m_index + 1] : '\0';
-    if (m_current == '\n')
-      _m_line++;
+// turns an index into an origin. note: a newline counts towards the line
+// it ends, and indexes must be requested in ascending order.
+Origin Lexer::get_origin(size_t index) {
+  size_t end = std::min(index + 1, m_input.size());
+  while (m_line_index < end) {
+    void const *newline =
+        std::memchr(m_input.data() + m_line_index, '\n', end - m_line_index);
+    if (!newline) {
+      m_line_index = end;
+      break;
+    }
+    m_line++;
+    m_line_index = static_cast<char const *>(newline) - m_input.data() + 1;
   }
-  return m_current;
+  return InputStreamPos{index, m_line, m_file};
 }
 
-// turn the current state into an origin.
-Origin Lexer::get_local_origin() { return InputStreamPos{m_index, _m_line}; }
-
 // gets next token from stream.
 std::vector<Token> Lexer::get_token_stream() {
-  while (m_current != '\0') {
-    bool match = false;
-    for (const auto &fn : matching_rules) {
-      std::optional<Token> token = fn();
-      if (token) {
-        m_token_stream.push_back(*token);
-        match = true;
-        break;
-      }
-    }
-    if (m_current == '\0')
+  while (true) {
+    skip_whitespace_comments();
+    unsigned char current = peek();
+    if (current == '\0')
+      break;
+
+    switch (CHAR_CLASSES[current]) {
+    case C_SYMBOL:
+      m_token_stream.push_back(symbol(SYMBOL_TYPES[current], 1));
+      break;
+    case C_DASH:
+      if (peek(1) == '>')
+        m_token_stream.push_back(symbol(TokenType::Arrow, 2));
+      else
+        m_token_stream.push_back(lex_identifier());
+      break;
+    case C_QUOTE:
+      lex_literal();
       break;
-    if (!match) {
-      ErrorHandler::push_error_throw(get_local_origin(), L_INVALID_SYMBOL);
+    case C_IDENTIFIER:
+      m_token_stream.push_back(lex_identifier());
+      break;
+    default:
+      ErrorHandler::push_error_throw(get_origin(m_index), L_INVALID_SYMBOL);
     }
   }
-  return m_token_stream;
+  return std::move(m_token_stream);
 }
 
 // skip all whitespace characters and comments.
-std::optional<Token> Lexer::skip_whitespace_comments() {
-  while (m_current == ' ' || m_current == '\n' || m_current == '\t' ||
-         m_current == '#') {
-    while (m_current == ' ' || m_current == '\n' || m_current == '\t')
-      consume_byte();
-    if (m_current != '#')
-      return std::nullopt; // not a comment.
-    while (m_current != '\n') {
-      consume_byte(); // currently in a comment.
+void Lexer::skip_whitespace_comments() {
+  while (m_index < m_input.size()) {
+    unsigned char char_class = CHAR_CLASSES[(unsigned char)m_input[m_index]];
+    if (char_class == C_WHITESPACE) {
+      m_index++;
+    } else if (char_class == C_COMMENT) {
+      // comments run until the end of the line, or the input.
+      void const *newline = std::memchr(m_input.data() + m_index, '\n',
+                                        m_input.size() - m_index);
+      m_index = newline ? static_cast<char const *>(newline) - m_input.data()
+                        : m_input.size();
+    } else {
+      return;
     }
   }
-  return std::nullopt;
 }
 
-// match =
-std::optional<Token> Lexer::match_equals() {
-  if (m_current != '=')
-    return std::nullopt;
-  consume_byte();
-  return Token{TokenType::Equals, std::nullopt, get_local_origin()};
-}
-
-// match :
-std::optional<Token> Lexer::match_modify() {
-  if (m_current != ':')
-    return std::nullopt;
-  consume_byte();
-  return Token{TokenType::Modify, std::nullopt, get_local_origin()};
-}
-
-// match ;
-std::optional<Token> Lexer::match_linestop() {
-  if (m_current != ';')
-    return std::nullopt;
-  consume_byte();
-  return Token{TokenType::LineStop, std::nullopt, get_local_origin()};
-}
-
-// match ->
-std::optional<Token> Lexer::match_arrow() {
-  if (!(m_current == '-' && m_next == '>'))
-    return std::nullopt;
-  consume_byte(2);
-  return Token{TokenType::Arrow, std::nullopt, get_local_origin()};
-}
-
-// match ,
-std::optional<Token> Lexer::match_separator() {
-  if (m_current != ',')
-    return std::nullopt;
-  consume_byte();
-  return Token{TokenType::Separator, std::nullopt, get_local_origin()};
-}
-
-// match [
-std::optional<Token> Lexer::match_expressionopen() {
-  if (m_current != '[')
-    return std::nullopt;
-  consume_byte();
-  return Token{TokenType::ExpressionOpen, std::nullopt, get_local_origin()};
-}
-
-// match ]
-std::optional<Token> Lexer::match_expressionclose() {
-  if (m_current != ']')
-    return std::nullopt;
-  consume_byte();
-  return Token{TokenType::ExpressionClose, std::nullopt, get_local_origin()};
-}
-
-// match {
-std::optional<Token> Lexer::match_taskopen() {
-  if (m_current != '{')
-    return std::nullopt;
-  consume_byte();
-  return Token{TokenType::TaskOpen, std::nullopt, get_local_origin()};
-}
-
-// match }
-std::optional<Token> Lexer::match_taskclose() {
-  if (m_current != '}')
-    return std::nullopt;
-  consume_byte();
-  return Token{TokenType::TaskClose, std::nullopt, get_local_origin()};
-}
-
-// match literals
-std::optional<Token> Lexer::match_literal() {
-  if (m_current != '\"')
-    return std::nullopt;
-  consume_byte();
-  Token formatted_literal = Token{
-      TokenType::FormattedLiteral,
-      std::vector<Token>{},
-      get_local_origin(),
-  };
-  std::string substr;
-  while (m_current != '\"') {
-    if (m_current == '[') {
-      consume_byte(); // consume the `[`.
-      std::get<CTX_VEC>(*formatted_literal.context)
-          .push_back(Token{TokenType::Literal, substr, get_local_origin()});
-      substr = "";
-      // lex escaped expression.
-      while (m_current != ']') {
-
-        std::optional<Token> inner_token;
-        skip_whitespace_comments();
-        // note: the parser only supports escaped identifiers
-        if ((inner_token = match_modify())) {
-        } else if ((inner_token = match_arrow())) {
-        } else if ((inner_token = match_separator())) {
-        } else if ((inner_token = match_identifier())) {
-        }
-
-        if (!inner_token)
-          ErrorHandler::push_error_throw(get_local_origin(), L_INVALID_LITERAL);
-
-        std::get<CTX_VEC>(*formatted_literal.context).push_back(*inner_token);
-      }
-      consume_byte(); // consume the `]`
-      continue;
+// consumes a fixed-length symbol.
+Token Lexer::symbol(TokenType type, size_t length) {
+  m_index += length;
+  return Token{type, std::nullopt, get_origin(m_index)};
+}
+
+// match literals. runs of plain characters are located with memchr and
+// referenced directly from the input. the contents are pushed right after
+// the formatted literal, which is given their number once it's terminated.
+void Lexer::lex_literal() {
+  m_index++; // consume the `"`.
+  size_t formatted_literal = m_token_stream.size();
+  m_token_stream.push_back(
+      Token{TokenType::FormattedLiteral, uint32_t{0}, get_origin(m_index)});
+
+  size_t start = m_index;
+  while (true) {
+    char const *begin = m_input.data() + m_index;
+    size_t remaining = m_input.size() - m_index;
+    char const *quote =
+        static_cast<char const *>(std::memchr(begin, '"', remaining));
+    size_t run = quote ? quote - begin : remaining;
+    char const *open = static_cast<char const *>(std::memchr(begin, '[', run));
+    if (!quote && !open) // unterminated literal.
+      ErrorHandler::push_error_throw(get_origin(m_input.size()),
+                                     L_INVALID_LITERAL);
+
+    // lex "pure" literal.
+    if (!open) {
+      m_index += run + 1; // consume the `"`.
+      m_token_stream.push_back(Token{TokenType::Literal,
+                                     m_input.substr(start, m_index - 1 - start),
+                                     get_origin(m_index)});
+      m_token_stream[formatted_literal].context =
+          uint32_t(m_token_stream.size() - formatted_literal - 1);
+      return;
     }
 
-    // lex "pure" literal:
-    substr += m_current;
-    consume_byte();
+    m_index += (open - begin) + 1; // consume the `[`.
+    m_token_stream.push_back(Token{TokenType::Literal,
+                                   m_input.substr(start, m_index - 1 - start),
+                                   get_origin(m_index)});
+
+    // lex escaped expression.
+    // note: the parser only supports escaped identifiers
+    while (true) {
+      skip_whitespace_comments();
+      unsigned char current = peek();
+      if (current == ']')
+        break;
+      if (current == ':')
+        m_token_stream.push_back(symbol(TokenType::Modify, 1));
+      else if (current == '-' && peek(1) == '>')
+        m_token_stream.push_back(symbol(TokenType::Arrow, 2));
+      else if (current == ',')
+        m_token_stream.push_back(symbol(TokenType::Separator, 1));
+      else if (is_alphabetic(current))
+        m_token_stream.push_back(lex_identifier());
+      else
+        ErrorHandler::push_error_throw(get_origin(m_index), L_INVALID_LITERAL);
+    }
+    m_index++; // consume the `]`.
+    start = m_index;
   }
-  consume_byte(); // consume the `"`
-  std::get<CTX_VEC>(*formatted_literal.context)
-      .push_back(Token{TokenType::Literal, substr, get_local_origin()});
-  return formatted_literal;
 }
 
 // match identifiers
-std::optional<Token> Lexer::match_identifier() {
-  if (!is_alphabetic(m_current))
-    return std::nullopt;
-  std::string identifier;
-  while (is_alphabetic(m_current)) {
-    identifier += m_current;
-    consume_byte();
-  }
+Token Lexer::lex_identifier() {
+  size_t start = m_index;
+  while (m_index < m_input.size() &&
+         is_alphabetic((unsigned char)m_input[m_index]))
+    m_index++;
+  std::string_view identifier = m_input.substr(start, m_index - start);
 
   if (identifier == "as")
-    return Token{TokenType::IterateAs, std::nullopt, get_local_origin()};
+    return Token{TokenType::IterateAs, std::nullopt, get_origin(m_index)};
   else if (identifier == "true")
-    return Token{TokenType::True, std::nullopt, get_local_origin()};
+    return Token{TokenType::True, std::nullopt, get_origin(m_index)};
   else if (identifier == "false")
-    return Token{TokenType::False, std::nullopt, get_local_origin()};
+    return Token{TokenType::False, std::nullopt, get_origin(m_index)};
+  else if (identifier == "import")
+    return Token{TokenType::Import, std::nullopt, get_origin(m_index)};
   else
-    return Token{TokenType::Identifier, identifier, get_local_origin()};
+    return Token{TokenType::Identifier, identifier, get_origin(m_index)};
 }
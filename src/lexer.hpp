@@ -3,36 +3,14 @@
 
 // token context indexes.
 #define CTX_STR 0
-#define CTX_VEC 1
+#define CTX_LEN 1
 
-// macro madness - this just generates the appropriate function signatures,
-// along with a vector of lambda functions calling every rule.
-// [note]: This does __not__ automatically match tokens inside of formatted
-// strings.
-#define LEXING_RULES(_MACRO)                                                   \
-  _MACRO(skip_whitespace_comments)                                             \
-  _MACRO(match_equals)                                                         \
-  _MACRO(match_modify)                                                         \
-  _MACRO(match_linestop)                                                       \
-  _MACRO(match_arrow)                                                          \
-  _MACRO(match_separator)                                                      \
-  _MACRO(match_expressionopen)                                                 \
-  _MACRO(match_expressionclose)                                                \
-  _MACRO(match_taskopen)                                                       \
-  _MACRO(match_taskclose)                                                      \
-  _MACRO(match_literal)                                                        \
-  _MACRO(match_identifier)
+#include "origin.hpp"
 
-#define _FUNCTION_DECLARE(x) std::optional<Token> x();
-#define FUNCTION_DECLARE_ALL LEXING_RULES(_FUNCTION_DECLARE)
-
-#define _LAMBDA_DECLARE(x) [this]() { return x(); }
-#define _LAMBDA_DECLARE_LIST(x) _LAMBDA_DECLARE(x),
-#define LAMBDA_DECLARE_ALL LEXING_RULES(_LAMBDA_DECLARE_LIST)
-
-#include <functional>
+#include <cstdint>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
@@ -53,27 +31,16 @@ enum class TokenType {
   TaskClose,        // `}`
   True,             // `true`
   False,            // `false`
+  Import,           // `import`
   Invalid,          // internal return type in parser
 };
 
-// small struct for tracking the origin of symbols.
-struct InputStreamPos {
-  size_t index;       // ASCII stream origin
-  size_t line;        // Line number
-  /* size_t length */ // Length of symbol for e.g. highlighting
-  bool operator==(InputStreamPos const &other) const {
-    return this->index == other.index && this->line == other.line;
-  }
-};
-struct InternalNode {};
-using ObjectReference = std::string;
-using Origin = std::variant<InputStreamPos, ObjectReference, InternalNode>;
+// note: strings are views into the input buffer passed to the lexer, which
+// has to outlive the tokens.
+using TokenContext = std::optional<std::variant<std::string_view, uint32_t>>;
 
-struct Token;
-using TokenContext =
-    std::optional<std::variant<std::string, std::vector<Token>>>;
-
-// defines a general token.
+// defines a general token. note: the contents of a formatted literal follow
+// it in the same stream, and their number is stored as its context.
 struct Token {
   TokenType type;
   TokenContext context;
@@ -83,25 +50,23 @@ struct Token {
 // work class.
 class Lexer {
 private:
-  std::vector<unsigned char> m_input;
+  std::string_view m_input;
   std::vector<Token> m_token_stream;
 
-  unsigned char m_current;
-  unsigned char m_next;
+  uint32_t m_file;
   size_t m_index;
-  size_t _m_line;
-
-  unsigned char consume_byte();
-  unsigned char consume_byte(int n);
-  Origin get_local_origin();
+  size_t m_line;
+  size_t m_line_index; // newlines before this index have been counted.
 
-  // here's the crazy macro magic.
-  FUNCTION_DECLARE_ALL
-  std::vector<std::function<std::optional<Token>(void)>> matching_rules{
-      LAMBDA_DECLARE_ALL};
+  unsigned char peek(size_t offset = 0) const;
+  Origin get_origin(size_t index);
+  void skip_whitespace_comments();
+  Token symbol(TokenType type, size_t length);
+  void lex_literal();
+  Token lex_identifier();
 
 public:
-  Lexer(std::vector<unsigned char> input_bytes);
+  Lexer(std::string_view input, uint32_t file = 0);
   std::vector<Token> get_token_stream();
 };
 
@@ -0,0 +1,171 @@
+#include "loader.hpp"
+#include "cache.hpp"
+#include "errors.hpp"
+#include "lexer.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+
+#include <exception>
+#include <filesystem>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
+
+// note: the root config has to be the first source.
+ConfigLoader::ConfigLoader(std::vector<ConfigSource> &sources, bool use_cache)
+    : m_sources(sources), m_use_cache(use_cache) {
+  std::error_code ec;
+  m_files[std::filesystem::weakly_canonical(m_sources[0].path, ec).string()] =
+      0;
+}
+
+// lexes and parses a single file, unless it has been parsed before.
+AST ConfigLoader::parse_source(uint32_t file) {
+  ConfigSource &source = m_sources[file];
+  std::string_view config = source.buffer.view();
+  std::string cache_path;
+  if (m_use_cache) {
+    std::stringstream path_ss;
+    path_ss << AST_CACHE_DIRECTORY << "/" << std::hex
+            << OSLayer::hash_content(config) << ".bin";
+    cache_path = path_ss.str();
+    m_cache_paths[file] = cache_path;
+    if ((source.cache = InputBuffer::map_file(cache_path))) {
+      TraceSpan span("load ast cache", source.path);
+      std::optional<AST> ast = ConfigCache::load_ast(*source.cache, config, file);
+      if (ast)
+        return std::move(*ast);
+      source.cache.reset();
+    }
+  }
+
+  TraceSpan lex_span("lex", source.path);
+  Lexer lexer(config, file);
+  std::vector<Token> token_stream = lexer.get_token_stream();
+  lex_span.end();
+
+  TraceSpan parse_span("parse", source.path);
+  Parser parser = Parser(token_stream);
+  AST ast = parser.parse_tokens();
+  parse_span.end();
+
+  if (m_use_cache) {
+    TraceSpan span("store ast cache", source.path);
+    std::error_code ec;
+    std::filesystem::create_directories(AST_CACHE_DIRECTORY, ec);
+    ConfigCache::store_ast(ast, config, cache_path);
+  }
+  return ast;
+}
+
+// imports are relative to the importing file. a file that is imported more
+// than once is only loaded the first time.
+std::optional<uint32_t> ConfigLoader::resolve_import(uint32_t file,
+                                                     Import const &import) {
+  std::filesystem::path path =
+      std::filesystem::path(m_sources[file].path).parent_path() /
+      std::filesystem::path(import.path);
+  std::error_code ec;
+  std::string canonical = std::filesystem::weakly_canonical(path, ec).string();
+  if (ec)
+    return std::nullopt;
+  auto existing = m_files.find(canonical);
+  if (existing != m_files.end())
+    return existing->second;
+
+  std::optional<InputBuffer> buffer = InputBuffer::map_file(path.string());
+  if (!buffer)
+    return std::nullopt;
+  m_sources.push_back({path.string(), std::move(*buffer), std::nullopt});
+  m_files[canonical] = m_sources.size() - 1;
+  return m_sources.size() - 1;
+}
+
+// every file of a wave is parsed in parallel, and the imports it declares
+// make up the next wave. the files are then merged depth-first, in the
+// order they were imported in.
+AST ConfigLoader::load() {
+  std::vector<std::optional<AST>> asts;
+  std::vector<std::vector<uint32_t>> imports;
+  size_t wave_begin = 0;
+  while (wave_begin < m_sources.size()) {
+    size_t wave_end = m_sources.size();
+    asts.resize(wave_end);
+    m_cache_paths.resize(wave_end);
+    if (wave_end - wave_begin == 1) {
+      asts[wave_begin] = parse_source(wave_begin);
+    } else {
+      // exceptions are rethrown once every thread has been joined, so that
+      // errors from any file (or e.g. bad_alloc) reach the caller.
+      std::vector<std::exception_ptr> exceptions(wave_end);
+      std::vector<std::thread> pool;
+      for (size_t i = wave_begin; i < wave_end; i++) {
+        Stats::add(Counter::ThreadsSpawned);
+        pool.push_back(std::thread([this, &asts, &exceptions, i]() {
+          try {
+            asts[i] = parse_source(i);
+          } catch (...) {
+            exceptions[i] = std::current_exception();
+          }
+        }));
+      }
+      for (std::thread &thread : pool)
+        thread.join();
+      for (std::exception_ptr const &exception : exceptions)
+        if (exception)
+          std::rethrow_exception(exception);
+    }
+
+    imports.resize(wave_end);
+    for (size_t i = wave_begin; i < wave_end; i++) {
+      for (Import const &import : asts[i]->imports) {
+        std::optional<uint32_t> imported = resolve_import(i, import);
+        if (!imported)
+          ErrorHandler::push_error_throw(import.origin, P_IMPORT_NOT_FOUND);
+        imports[i].push_back(*imported);
+      }
+    }
+    wave_begin = wave_end;
+  }
+
+  size_t nodes = 0, children = 0;
+  for (std::optional<AST> const &file_ast : asts) {
+    nodes += file_ast->nodes.size();
+    children += file_ast->children.size();
+  }
+  AST ast = std::move(*asts[0]);
+  ast.nodes.reserve(nodes);
+  ast.children.reserve(children);
+  std::vector<bool> merged(asts.size(), false);
+  std::vector<uint32_t> pending(imports[0].rbegin(), imports[0].rend());
+  merged[0] = true;
+  while (!pending.empty()) {
+    uint32_t file = pending.back();
+    pending.pop_back();
+    if (merged[file])
+      continue;
+    merged[file] = true;
+    ast.merge(std::move(*asts[file]));
+    pending.insert(pending.end(), imports[file].rbegin(), imports[file].rend());
+  }
+  ast.imports.clear();
+  if (m_use_cache)
+    prune_cache();
+  return ast;
+}
+
+// removes the cached ASTs of files that are no longer part of the config,
+// which would otherwise pile up as the files are edited.
+void ConfigLoader::prune_cache() const {
+  std::unordered_set<std::string> used;
+  for (std::string const &path : m_cache_paths)
+    used.insert(std::filesystem::path(path).filename().string());
+  std::error_code ec;
+  for (std::filesystem::directory_entry const &entry :
+       std::filesystem::directory_iterator(AST_CACHE_DIRECTORY, ec)) {
+    // note: temporary files of other processes are left alone.
+    std::filesystem::path path = entry.path();
+    if (path.extension() == ".bin" && !used.count(path.filename().string()))
+      std::filesystem::remove(path, ec);
+  }
+}
@@ -0,0 +1,43 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include "oslayer.hpp"
+#include "parser.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// parsed config files are cached by their contents.
+#define AST_CACHE_DIRECTORY ".quickbuild/ast"
+
+// a single config file. its index in the list of sources is the file id
+// used by origins, and the root config is always 0.
+struct ConfigSource {
+  std::string path;
+  InputBuffer buffer;
+  std::optional<InputBuffer> cache; // parsed AST, if one was cached.
+};
+
+// lexes and parses the root config and everything it imports. files are
+// parsed in waves, with every file of a wave on its own thread, and then
+// merged into a single AST.
+class ConfigLoader {
+private:
+  std::vector<ConfigSource> &m_sources;
+  std::unordered_map<std::string, uint32_t> m_files; // by canonical path.
+  std::vector<std::string> m_cache_paths; // of every source, once parsed.
+  bool m_use_cache;
+
+  AST parse_source(uint32_t file);
+  std::optional<uint32_t> resolve_import(uint32_t file, Import const &import);
+  void prune_cache() const;
+
+public:
+  ConfigLoader(std::vector<ConfigSource> &sources, bool use_cache);
+  AST load();
+};
+
+#endif
@@ -0,0 +1,140 @@
+#include "log.hpp"
+
+#include <cerrno>
+#include <streambuf>
+#include <thread>
+#include <unistd.h>
+
+bool const Log::s_colors = isatty(STDOUT_FILENO);
+std::atomic<LogEntry *> Log::s_pending = nullptr;
+std::atomic<size_t> Log::s_pending_size = 0;
+std::atomic<bool> Log::s_writing = false;
+
+// appends everything written to it to a string, which unlike the one of an
+// ostringstream can be handed over without copying it.
+class LogBuffer : public std::streambuf {
+public:
+  std::string text;
+
+protected:
+  int_type overflow(int_type c) override {
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+      text.push_back(traits_type::to_char_type(c));
+    return c;
+  }
+  std::streamsize xsputn(char const *s, std::streamsize n) override {
+    text.append(s, n);
+    return n;
+  }
+};
+
+// entries that have been written, from first to last.
+static std::atomic<LogEntry *> free_entries = nullptr;
+
+static void free_list(LogEntry *first, LogEntry *last) {
+  last->next = free_entries.load(std::memory_order_relaxed);
+  while (!free_entries.compare_exchange_weak(last->next, first,
+                                             std::memory_order_release))
+    ;
+}
+
+struct LogThread {
+  LogBuffer buffer;
+  std::ostream stream{&buffer};
+  LogEntry *free = nullptr; // entries that only this thread takes from.
+
+  // hands back the entries that weren't used, e.g. by a worker.
+  ~LogThread() {
+    if (!free)
+      return;
+    LogEntry *last = free;
+    while (last->next)
+      last = last->next;
+    free_list(free, last);
+  }
+};
+
+static LogThread &log_thread() {
+  static thread_local LogThread thread;
+  return thread;
+}
+
+std::ostream &Log::begin() {
+  LogThread &thread = log_thread();
+  thread.buffer.text.clear();
+  return thread.stream;
+}
+
+// note: free entries are taken all at once, since popping a single entry
+// off a lock-free stack is prone to ABA.
+void Log::end(bool newline) {
+  LogThread &thread = log_thread();
+  if (newline)
+    thread.buffer.text += '\n';
+  if (!thread.free)
+    thread.free = free_entries.exchange(nullptr, std::memory_order_acquire);
+  LogEntry *entry = thread.free;
+  if (entry)
+    thread.free = entry->next;
+  else
+    entry = new LogEntry{{}, nullptr};
+  // the buffer takes over the capacity of the entry's previous text.
+  entry->text.swap(thread.buffer.text);
+  size_t size = entry->text.size();
+  size_t queued = s_pending_size.fetch_add(size) + size;
+
+  entry->next = s_pending.load(std::memory_order_relaxed);
+  while (!s_pending.compare_exchange_weak(entry->next, entry))
+    ;
+  if (queued >= LOG_BATCH_SIZE || s_colors)
+    drain();
+}
+
+// note: the queue is checked again once the writer has stepped down, as
+// anything that was pushed while it was writing may not have a writer yet.
+void Log::drain() {
+  static std::string batch; // only used by the writer.
+  while (s_pending.load() && !s_writing.exchange(true)) {
+    LogEntry *entries = s_pending.exchange(nullptr);
+
+    // the queue is last in, first out.
+    LogEntry *ordered = nullptr;
+    LogEntry *last = entries;
+    while (entries) {
+      LogEntry *next = entries->next;
+      entries->next = ordered;
+      ordered = entries;
+      entries = next;
+    }
+    batch.clear();
+    for (LogEntry *entry = ordered; entry; entry = entry->next) {
+      batch += entry->text;
+      entry->text.clear();
+    }
+    s_pending_size.fetch_sub(batch.size());
+
+    // the written entries are handed back as a whole.
+    if (last)
+      free_list(ordered, last);
+
+    size_t written = 0;
+    while (written < batch.size()) {
+      ssize_t n = write(STDOUT_FILENO, batch.data() + written,
+                        batch.size() - written);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        break;
+      written += n;
+    }
+    s_writing.store(false);
+  }
+}
+
+void Log::flush() {
+  drain();
+  while (s_pending.load() || s_writing.load()) {
+    std::this_thread::yield();
+    drain();
+  }
+}
@@ -0,0 +1,44 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <atomic>
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+// queued output is written once this much has piled up, unless it's flushed
+// earlier.
+#define LOG_BATCH_SIZE (64 * 1024)
+
+// a single line (or part of one) that is waiting to be written. entries are
+// reused once they have been written, along with the capacity of their text.
+struct LogEntry {
+  std::string text;
+  LogEntry *next;
+};
+
+// every thread formats its messages into its own buffer and pushes them onto
+// a lock-free queue. the queue is written with a single write once it's large
+// enough, or when it's flushed, e.g. before a command writes to stdout
+// itself. a terminal is written to after every message instead, like stdio
+// does, so that the progress of the build can be followed.
+class Log {
+private:
+  static bool const s_colors;
+  static std::atomic<LogEntry *> s_pending;
+  static std::atomic<size_t> s_pending_size;
+  static std::atomic<bool> s_writing;
+  static void drain();
+
+public:
+  // whether stdout is a terminal, which is only checked once.
+  static bool colors() { return s_colors; }
+  // the buffer of the current thread, emptied.
+  static std::ostream &begin();
+  // queues the buffer of the current thread.
+  static void end(bool newline);
+  // waits until everything that has been queued is written.
+  static void flush();
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "driver.hpp"
+#include <cstdlib>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -23,6 +24,28 @@ int main(int argc, char **argv) {
       setup.logging_level = LoggingLevel::Verbose;
     else if (arg == "--dry-run")
       setup.dry_run = true;
+    else if (arg.rfind("--trace=", 0) == 0)
+      setup.trace = arg.substr(sizeof("--trace=") - 1);
+    else if (arg == "--summary")
+      setup.summary = true;
+    else if (arg == "--stats")
+      setup.stats = true;
+    else if (arg == "--explain")
+      setup.explain = true;
+    else if (arg == "-k" || arg == "--keep-going")
+      setup.keep_going = true;
+    else if (arg.rfind("--jobs=", 0) == 0 || arg.rfind("-j", 0) == 0) {
+      std::string jobs =
+          arg.substr(arg[1] == 'j' ? sizeof("-j") - 1 : sizeof("--jobs=") - 1);
+      char *end;
+      setup.jobs = std::strtoul(jobs.c_str(), &end, 10);
+      if (jobs.empty() || *end != '\0' || 0 == setup.jobs) {
+        std::cerr << "Error: Invalid number of jobs. Cannot proceed."
+                  << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    } else if (arg.rfind("--summary-json=", 0) == 0)
+      setup.summary_json = arg.substr(sizeof("--summary-json=") - 1);
     else if (arg == "--help") {
       std::cout << "Usage: quickbuild [arguments] <task>\n"
                    "  --stdin: reads config from stdin\n"
@@ -31,6 +54,16 @@ int main(int argc, char **argv) {
                    "  --log-standard: sets logging level to standard\n"
                    "  --log-verbose: sets logging level to verbose\n"
                    "  --dry-run: doesn't execute any commands\n"
+                   "  --trace=<file>: writes a chrome trace of the build\n"
+                   "  --summary: shows the slowest tasks after the build\n"
+                   "  --summary-json=<file>: writes the summary as json\n"
+                   "  --stats: shows internal counters after the build\n"
+                   "  --explain: shows why every task is run\n"
+                   "  -j<n>, --jobs=<n>: runs at most n commands at once, one "
+                   "per core by default\n"
+                   "  -k, --keep-going: keeps building what doesn't depend on "
+                   "a failed task\n"
+                   "    (by default, the build stops at the first failure)\n"
                    "  --help: shows this message and exits\n";
       exit(EXIT_SUCCESS);
     } else if (!setup.task)
@@ -0,0 +1,59 @@
+#include "origin.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// positions are stored in fixed-size chunks, so that they can be appended
+// from multiple threads (e.g. while parsing imports) without moving.
+#define ORIGIN_CHUNK_BITS 16
+#define ORIGIN_CHUNK_SIZE (1u << ORIGIN_CHUNK_BITS)
+#define ORIGIN_MAX_CHUNKS (1u << 15)
+// set on the ids of object references.
+#define ORIGIN_REFERENCE_BIT (1u << 31)
+
+static std::atomic<InputStreamPos *> position_chunks[ORIGIN_MAX_CHUNKS];
+static std::atomic<uint32_t> next_position = 1;
+static std::mutex origin_lock;
+static std::vector<ObjectReference> references;
+static std::unordered_map<ObjectReference, uint32_t> reference_ids;
+
+Origin::Origin(InputStreamPos const &pos) {
+  uint32_t id = next_position.fetch_add(1, std::memory_order_relaxed);
+  uint32_t chunk = id >> ORIGIN_CHUNK_BITS;
+  if (chunk >= ORIGIN_MAX_CHUNKS)
+    return; // out of ids, fall back to an internal node.
+  InputStreamPos *positions =
+      position_chunks[chunk].load(std::memory_order_acquire);
+  if (!positions) {
+    std::lock_guard<std::mutex> guard(origin_lock);
+    positions = position_chunks[chunk].load(std::memory_order_relaxed);
+    if (!positions) {
+      positions = new InputStreamPos[ORIGIN_CHUNK_SIZE];
+      position_chunks[chunk].store(positions, std::memory_order_release);
+    }
+  }
+  positions[id & (ORIGIN_CHUNK_SIZE - 1)] = pos;
+  this->id = id;
+}
+
+Origin::Origin(ObjectReference const &ref) {
+  std::lock_guard<std::mutex> guard(origin_lock);
+  auto [it, inserted] = reference_ids.emplace(ref, references.size());
+  if (inserted)
+    references.push_back(ref);
+  this->id = it->second | ORIGIN_REFERENCE_BIT;
+}
+
+// note: only used when reporting errors and writing caches.
+OriginInfo Origin::info() const {
+  if (id == 0)
+    return InternalNode{};
+  if (id & ORIGIN_REFERENCE_BIT) {
+    std::lock_guard<std::mutex> guard(origin_lock);
+    return references[id & ~ORIGIN_REFERENCE_BIT];
+  }
+  return position_chunks[id >> ORIGIN_CHUNK_BITS].load(
+      std::memory_order_acquire)[id & (ORIGIN_CHUNK_SIZE - 1)];
+}
@@ -0,0 +1,38 @@
+#ifndef ORIGIN_H
+#define ORIGIN_H
+
+#include <cstdint>
+#include <string>
+#include <variant>
+
+// small struct for tracking the origin of symbols.
+struct InputStreamPos {
+  size_t index;       // ASCII stream origin
+  size_t line;        // Line number
+  uint32_t file = 0;  // Config file, the root config is always 0
+  /* size_t length */ // Length of symbol for e.g. highlighting
+  bool operator==(InputStreamPos const &other) const {
+    return this->index == other.index && this->line == other.line &&
+           this->file == other.file;
+  }
+};
+struct InternalNode {};
+using ObjectReference = std::string;
+using OriginInfo = std::variant<InputStreamPos, ObjectReference, InternalNode>;
+
+// every token, AST node and value carries an origin, so they're stored as a
+// 32-bit id into a global side table rather than by value. positions are
+// appended to the table, while object references are interned.
+// note: the table is never cleared, ids stay valid for the entire process.
+struct Origin {
+  uint32_t id = 0; // 0 is always an internal node.
+
+  Origin() = default;
+  Origin(InternalNode) {}
+  Origin(InputStreamPos const &pos);
+  Origin(ObjectReference const &ref);
+  OriginInfo info() const;
+  bool operator==(Origin const &other) const { return id == other.id; }
+};
+
+#endif
@@ -1,6 +1,32 @@
 #include "oslayer.hpp"
+#include "jobs.hpp"
+#include "log.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
 #include <sys/stat.h>
 
+#ifndef WIN32
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char **environ;
+#else
+#include <io.h>
+#include <process.h>
+#define getpid _getpid
+#endif
+
 // this might incorrectly modify struct name.
 #ifdef WIN32
 #define stat _stat
@@ -9,17 +35,97 @@
 // account for darwin naming conventions.
 #ifdef __APPLE__
 #define ST_CTIME st_ctimespec.tv_sec
+#define RU_MAXRSS_KIB(ru) ((ru).ru_maxrss / 1024)
 #else
 #define ST_CTIME st_ctime
+#define RU_MAXRSS_KIB(ru) ((ru).ru_maxrss)
+#endif
+
+InputBuffer::~InputBuffer() {
+#ifndef WIN32
+  if (m_mapping)
+    munmap(m_mapping, m_mapping_size);
 #endif
+}
+
+InputBuffer::InputBuffer(InputBuffer &&other) noexcept {
+  *this = std::move(other);
+}
 
-OSLayer::OSLayer(bool parallel, bool silent) {
+InputBuffer &InputBuffer::operator=(InputBuffer &&other) noexcept {
+  std::swap(m_contents, other.m_contents);
+  std::swap(m_mapping, other.m_mapping);
+  std::swap(m_mapping_size, other.m_mapping_size);
+  return *this;
+}
+
+// maps a file read-only. falls back to reading it if it can't be mapped,
+// e.g. if it's empty or not a regular file.
+std::optional<InputBuffer> InputBuffer::map_file(std::string const &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (0 > fd)
+    return std::nullopt;
+  InputBuffer buffer;
+#ifndef WIN32
+  struct stat t_stat;
+  if (0 == fstat(fd, &t_stat) && S_ISREG(t_stat.st_mode) &&
+      t_stat.st_size > 0) {
+    void *mapping =
+        mmap(nullptr, t_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping != MAP_FAILED) {
+      madvise(mapping, t_stat.st_size, MADV_SEQUENTIAL);
+      buffer.m_mapping = mapping;
+      buffer.m_mapping_size = t_stat.st_size;
+      close(fd);
+      return buffer;
+    }
+  }
+#endif
+  buffer = read_stream(fd);
+  close(fd);
+  return buffer;
+}
+
+// reads a stream until its end, including any newlines.
+InputBuffer InputBuffer::read_stream(int fd) {
+  InputBuffer buffer;
+  size_t size = 0;
+  while (true) {
+    buffer.m_contents.resize(size + INPUT_BLOCK_SIZE);
+    long n = read(fd, buffer.m_contents.data() + size, INPUT_BLOCK_SIZE);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    size += n;
+  }
+  buffer.m_contents.resize(size);
+  return buffer;
+}
+
+std::string_view InputBuffer::view() const {
+  if (m_mapping)
+    return std::string_view(static_cast<char const *>(m_mapping),
+                            m_mapping_size);
+  return std::string_view(reinterpret_cast<char const *>(m_contents.data()),
+                          m_contents.size());
+}
+
+OSLayer::OSLayer(bool parallel, bool silent, uint64_t priority,
+                 bool response_files) {
   this->parallel = parallel;
   this->silent = silent;
+  this->priority = priority;
+  this->response_files = response_files;
 }
 
-void OSLayer::queue_command(Command command) { queue.push_back(command); }
+void OSLayer::queue_command(Command command) {
+  queue.push_back(std::move(command));
+}
 
+// the usage of the commands is summed up, except for the wall time of
+// parallel commands, which is that of the slowest one. the time spent
+// waiting for a job slot isn't included.
 void OSLayer::execute_queue() {
   if (parallel)
     _execute_queue_parallel();
@@ -29,39 +135,262 @@ void OSLayer::execute_queue() {
 
 void OSLayer::_execute_queue_parallel() {
   std::vector<std::thread> pool;
-  for (Command const &command : queue) {
-    pool.push_back(std::thread(&OSLayer::_execute_command, this, command));
+  std::vector<ResourceUsage> usages(queue.size());
+  for (size_t i = 0; i < queue.size(); i++) {
+    Stats::add(Counter::ThreadsSpawned);
+    pool.push_back(std::thread([this, &usages, i]() {
+      usages[i] = _execute_command(queue[i]);
+    }));
   }
-  queue = {};
   for (std::thread &thread : pool) {
     thread.join();
   }
+  for (ResourceUsage const &command_usage : usages) {
+    usage.wall = std::max(usage.wall, command_usage.wall);
+    usage.user += command_usage.user;
+    usage.system += command_usage.system;
+    usage.max_rss = std::max(usage.max_rss, command_usage.max_rss);
+    usage.commands += command_usage.commands;
+  }
+  queue = {};
 }
 
 void OSLayer::_execute_queue_sync() {
   for (Command const &command : queue) {
-    _execute_command(command);
+    ResourceUsage command_usage = _execute_command(command);
+    usage.wall += command_usage.wall;
+    usage.user += command_usage.user;
+    usage.system += command_usage.system;
+    usage.max_rss = std::max(usage.max_rss, command_usage.max_rss);
+    usage.commands += command_usage.commands;
   }
   queue = {};
 }
 
-void OSLayer::_execute_command(Command command) {
-  int code;
-  if (silent)
-    code = system((command.cmdline + " 1>/dev/null 2>&1").c_str());
-  else
-    code = system(command.cmdline.c_str());
+ResourceUsage OSLayer::_execute_command(Command const &command) {
+  JobSlot slot(priority);
+  if (!slot.acquired()) {
+    cancelled = true;
+    return {};
+  }
+  TraceSpan span("command", command.cmdline);
+  std::optional<std::string> spilled;
+  if (response_files && command.cmdline.size() > RESPONSE_FILE_THRESHOLD)
+    spilled = _spill_command(command);
+  std::string const &cmdline = spilled ? *spilled : command.cmdline;
 
-  if (0 != code) {
+  ResourceUsage command_usage;
+  command_usage.commands = 1; // commands that were cancelled aren't counted.
+  auto start = std::chrono::steady_clock::now();
+  int code = _spawn_shell(cmdline, command_usage);
+  command_usage.wall = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+
+  // commands that were terminated because the build was cancelled didn't
+  // fail on their own.
+  if (0 != code && Jobs::cancelled()) {
+    cancelled = true;
+  } else if (0 != code) {
     this->error_lock.lock();
     errors.push_back({command.origin, command.cmdline});
     this->error_lock.unlock();
+    Jobs::fail();
+  }
+  return command_usage;
+}
+
+// runs a command with `sh -c` and waits for it, collecting the resources it
+// used. returns its exit status, or -1 if it couldn't be run.
+int OSLayer::_spawn_shell(std::string const &cmdline, ResourceUsage &usage) {
+  Stats::add(Counter::CommandsRun);
+  // the command writes to stdout itself, after what has been logged so far.
+  if (!silent)
+    Log::flush();
+#ifndef WIN32
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  if (silent) {
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null",
+                                     O_WRONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+  }
+  // commands get their own process group if possible, so that everything
+  // they start can be terminated at once. signals that quickbuild forwards
+  // are blocked in its own threads, but not in the command.
+  posix_spawnattr_t attributes;
+  posix_spawnattr_init(&attributes);
+  short flags = POSIX_SPAWN_SETSIGMASK;
+  if (Jobs::process_groups())
+    flags |= POSIX_SPAWN_SETPGROUP;
+  posix_spawnattr_setflags(&attributes, flags);
+  posix_spawnattr_setpgroup(&attributes, 0);
+  sigset_t signals;
+  sigemptyset(&signals);
+  posix_spawnattr_setsigmask(&attributes, &signals);
+  char const *argv[] = {"sh", "-c", cmdline.c_str(), nullptr};
+  pid_t pid;
+  int spawn_error = posix_spawn(&pid, "/bin/sh", &actions, &attributes,
+                                const_cast<char *const *>(argv), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attributes);
+  if (0 != spawn_error)
+    return -1;
+
+  Jobs::track(pid);
+  // a command in its own process group is stopped if it reads from the
+  // terminal anyway, e.g. from /dev/tty, and nothing would ever continue
+  // it. it's killed instead of waiting forever.
+  int options = WEXITED | WNOWAIT | (Jobs::process_groups() ? WSTOPPED : 0);
+  siginfo_t info;
+  while (true) {
+    if (waitid(P_PID, pid, &info, options) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    if (info.si_code != CLD_STOPPED)
+      break;
+    // consumes the stop, but not the exit.
+    while (waitid(P_PID, pid, &info, WSTOPPED) < 0 && errno == EINTR)
+      ;
+    kill(-pid, SIGKILL);
+  }
+  Jobs::untrack(pid);
+
+  int status;
+  struct rusage child_usage;
+  pid_t result;
+  do {
+    result = wait4(pid, &status, 0, &child_usage);
+  } while (result < 0 && errno == EINTR);
+  if (result < 0)
+    return -1;
+
+  usage.user = child_usage.ru_utime.tv_sec + child_usage.ru_utime.tv_usec / 1e6;
+  usage.system =
+      child_usage.ru_stime.tv_sec + child_usage.ru_stime.tv_usec / 1e6;
+  usage.max_rss = RU_MAXRSS_KIB(child_usage);
+  if (WIFEXITED(status))
+    return WEXITSTATUS(status);
+  return -1; // killed by a signal.
+#else
+  // note: resources aren't tracked on windows.
+  if (silent)
+    return system((cmdline + " 1>NUL 2>&1").c_str());
+  return system(cmdline.c_str());
+#endif
+}
+
+// replaces the largest list expansions of a command with `@file` until it
+// fits. returns nothing if it can't be shortened, in which case the
+// command is executed as is.
+std::optional<std::string> OSLayer::_spill_command(Command const &command) {
+  std::vector<size_t> order(command.expansions.size());
+  for (size_t i = 0; i < order.size(); i++)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    IExpansion const &x = command.expansions[a];
+    IExpansion const &y = command.expansions[b];
+    return x.end - x.begin > y.end - y.begin;
+  });
+
+  // the path of a response file is never longer than this.
+  size_t const reference_size =
+      sizeof(RESPONSE_FILE_DIRECTORY "/@0123456789abcdef.rsp");
+  std::vector<bool> spill(order.size(), false);
+  size_t size = command.cmdline.size();
+  for (size_t i = 0; i < order.size() && size > RESPONSE_FILE_THRESHOLD;
+       i++) {
+    IExpansion const &expansion = command.expansions[order[i]];
+    if (expansion.end - expansion.begin <= reference_size)
+      break;
+    spill[order[i]] = true;
+    size -= expansion.end - expansion.begin - reference_size;
   }
+  if (size > RESPONSE_FILE_THRESHOLD)
+    return std::nullopt;
+
+  std::string cmdline;
+  cmdline.reserve(size);
+  size_t offset = 0;
+  for (size_t i = 0; i < command.expansions.size(); i++) {
+    if (!spill[i])
+      continue;
+    IExpansion const &expansion = command.expansions[i];
+    std::optional<std::string> path = _write_response_file(
+        std::string_view(command.cmdline)
+            .substr(expansion.begin, expansion.end - expansion.begin));
+    if (!path)
+      return std::nullopt;
+    cmdline.append(command.cmdline, offset, expansion.begin - offset);
+    cmdline += '@';
+    cmdline += *path;
+    offset = expansion.end;
+  }
+  cmdline.append(command.cmdline, offset);
+  return cmdline;
+}
+
+// response files are named after their contents, so that a file that is
+// still there from an earlier build (or another command) is reused as is,
+// and tools that track their inputs don't see it change.
+// note: files are written atomically, so an existing one is always complete.
+std::optional<std::string>
+OSLayer::_write_response_file(std::string_view content) {
+  std::stringstream path_ss;
+  path_ss << RESPONSE_FILE_DIRECTORY << "/" << std::hex << std::setfill('0')
+          << std::setw(16) << hash_content(content) << ".rsp";
+  std::string path = path_ss.str();
+  if (get_file_timestamp(path))
+    return path;
+
+  std::error_code ec;
+  std::filesystem::create_directories(RESPONSE_FILE_DIRECTORY, ec);
+  std::string contents;
+  contents.reserve(content.size() + 1);
+  contents.append(content);
+  contents += '\n';
+  if (!write_file_atomic(path, contents))
+    return std::nullopt;
+  return path;
+}
+
+// 64-bit FNV-1a.
+uint64_t OSLayer::hash_content(std::string_view content) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (char c : content)
+    hash = (hash ^ (unsigned char)c) * 0x100000001b3;
+  return hash;
+}
+
+// writes to a temporary file first, since other threads (or processes)
+// might be reading the file at the same time.
+bool OSLayer::write_file_atomic(std::string const &path,
+                                std::string_view content) {
+  std::stringstream temp_ss;
+  temp_ss << path << "." << getpid() << "." << std::this_thread::get_id();
+  std::string temp = temp_ss.str();
+  std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+  file.write(content.data(), content.size());
+  file.close();
+  std::error_code ec;
+  if (!file) {
+    std::filesystem::remove(temp, ec);
+    return false;
+  }
+  std::filesystem::rename(temp, path, ec);
+  return !ec;
+}
+
+std::optional<size_t> OSLayer::get_file_timestamp(std::string const &path) {
+  return get_file_timestamp(path.c_str());
 }
 
-std::optional<size_t> OSLayer::get_file_timestamp(std::string path) {
+std::optional<size_t> OSLayer::get_file_timestamp(char const *path) {
+  Stats::add(Counter::StatCalls);
   struct stat t_stat;
-  if (0 > stat(path.c_str(), &t_stat))
+  if (0 > stat(path, &t_stat))
     return std::nullopt;
   return t_stat.ST_CTIME;
 }
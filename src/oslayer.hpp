@@ -3,39 +3,105 @@
 
 #include "errors.hpp"
 #include "lexer.hpp"
+#include "values.hpp"
 #include <atomic>
 #include <mutex>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <vector>
 
+// commands are passed to `sh -c` as a single argument, which linux caps
+// at 128 KiB regardless of ARG_MAX. longer commands of tasks that opt in
+// have their list expansions spilled into response files.
+#define RESPONSE_FILE_THRESHOLD (96 * 1024)
+#define RESPONSE_FILE_DIRECTORY ".quickbuild/rsp"
+// lists that are joined into strings at least this long are recorded as
+// expansions even if the string is short, since it may end up nested in a
+// longer command.
+#define RESPONSE_FILE_MIN_EXPANSION (4 * 1024)
+
 struct Command {
   std::string cmdline;
   Origin origin;
+  std::vector<IExpansion> expansions;
+};
+
+// resources used by one or more commands. times are in seconds, and the
+// wall time doesn't include waiting for a job slot.
+struct ResourceUsage {
+  double wall = 0;
+  double user = 0;
+  double system = 0;
+  size_t max_rss = 0; // KiB, the largest of any single command.
+  size_t commands = 0;
+};
+
+// size of the blocks that stdin is read in.
+#define INPUT_BLOCK_SIZE (256 * 1024)
+
+// read-only input, borrowed by the lexer, parser and error reporter. files
+// are mapped into memory rather than copied, while streams are read in
+// large blocks.
+class InputBuffer {
+private:
+  std::vector<unsigned char> m_contents; // used if nothing is mapped.
+  void *m_mapping = nullptr;
+  size_t m_mapping_size = 0;
+
+public:
+  InputBuffer() = default;
+  ~InputBuffer();
+  InputBuffer(InputBuffer &&other) noexcept;
+  InputBuffer &operator=(InputBuffer &&other) noexcept;
+  InputBuffer(InputBuffer const &) = delete;
+  InputBuffer &operator=(InputBuffer const &) = delete;
+
+  static std::optional<InputBuffer> map_file(std::string const &path);
+  static InputBuffer read_stream(int fd);
+  std::string_view view() const;
 };
 
 class OSLayer {
 private:
   bool silent;
   bool parallel;
+  uint64_t priority; // of the job slots that the commands wait for.
+  bool response_files;
 
   std::vector<Command> queue = {};
   std::vector<ErrorContext> errors;
   std::mutex error_lock;
+  std::atomic<bool> cancelled = false;
+  ResourceUsage usage;
 
-  void _execute_command(Command command);
+  ResourceUsage _execute_command(Command const &command);
+  int _spawn_shell(std::string const &cmdline, ResourceUsage &usage);
+  static std::optional<std::string>
+  _spill_command(Command const &command);
+  static std::optional<std::string>
+  _write_response_file(std::string_view content);
 
   void _execute_queue_sync();
   void _execute_queue_parallel();
 
 public:
-  OSLayer(bool parallel, bool silent);
+  OSLayer(bool parallel, bool silent, uint64_t priority = 0,
+          bool response_files = false);
   void queue_command(Command command);
   void execute_queue();
   std::vector<ErrorContext> get_errors();
+  ResourceUsage get_usage() const { return usage; }
+  // whether any command was skipped or terminated because the build was
+  // cancelled.
+  bool was_cancelled() const { return cancelled; }
 
-  static std::optional<size_t> get_file_timestamp(std::string path);
+  static std::optional<size_t> get_file_timestamp(std::string const &path);
+  static std::optional<size_t> get_file_timestamp(char const *path);
+  static uint64_t hash_content(std::string_view content);
+  static bool write_file_atomic(std::string const &path,
+                                std::string_view content);
 };
 
 #endif
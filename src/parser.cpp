@@ -1,36 +1,12 @@
 #include "parser.hpp"
 #include "errors.hpp"
 #include "lexer.hpp"
-#include <memory>
 
 #define ITERATOR_INTERNAL                                                      \
   Identifier {                                                                 \
     "__task__", InternalNode {}                                                \
   }
 
-// equality operators for AST objects.
-bool Identifier::operator==(Identifier const &other) const {
-  // return this->content == other.content && this->origin == other.origin;
-  return this->content == other.content;
-}
-bool Literal::operator==(Literal const &other) const {
-  return this->content == other.content;
-}
-bool FormattedLiteral::operator==(FormattedLiteral const &other) const {
-  return this->contents == other.contents;
-}
-bool Boolean::operator==(Boolean const &other) const {
-  return this->content == other.content;
-}
-bool Replace::operator==(Replace const &other) const {
-  return this->identifier == other.identifier &&
-         *(this->original) == *(other.original) &&
-         *(this->replacement) == *(other.replacement);
-}
-bool List::operator==(List const &other) const {
-  return this->contents == other.contents;
-}
-
 // visitor that simply returns the origin of an AST object.
 struct ASTVisitOrigin {
   Origin operator()(Identifier const &identifier) { return identifier.origin; }
@@ -43,70 +19,120 @@ struct ASTVisitOrigin {
   Origin operator()(Replace const &replace) { return replace.origin; }
 };
 
-// initialises fields.
-Parser::Parser(std::vector<Token> token_stream) : m_ast() {
-  m_token_stream = token_stream;
+// the origin should never be read, so we can keep this as an internalnode.
+static const Token INVALID_TOKEN =
+    Token{TokenType::Invalid, "__invalid__", InternalNode{}};
+
+// initialises fields. note: the token stream is borrowed, not copied.
+Parser::Parser(std::vector<Token> const &token_stream)
+    : m_token_stream(token_stream), m_ast() {
   m_index = 0;
-  // the origin should never be read, so we can keep this as an internalnode.
-  m_current = (m_token_stream.size() >= m_index + 1)
-                  ? m_token_stream[m_index]
-                  : Token{TokenType::Invalid, "__invalid__", InternalNode{}};
-  m_next = (m_token_stream.size() >= m_index + 2)
-               ? m_token_stream[m_index + 1]
-               : Token{TokenType::Invalid, "__invalid__", InternalNode{}};
 }
 
-// token checking, no side effects.
-bool Parser::check_current(TokenType token_type) {
-  return m_current.type == token_type;
+// token lookahead, no side effects.
+Token const &Parser::peek(size_t offset) const {
+  return (m_index + offset < m_token_stream.size())
+             ? m_token_stream[m_index + offset]
+             : INVALID_TOKEN;
 }
 
 // token checking, no side effects.
-bool Parser::check_next(TokenType token_type) {
-  return m_next.type == token_type;
+bool Parser::check_current(TokenType token_type) const {
+  return peek().type == token_type;
 }
 
-// consume a token.
-Token Parser::consume_token() { return consume_token(1); }
-
-// consume n tokens.
-Token Parser::consume_token(int n) {
-  m_index += n;
-  m_previous = m_current;
-  // the origin should never be read, so we can keep it as 0.
-  m_current = (m_token_stream.size() >= m_index + 1)
-                  ? m_token_stream[m_index]
-                  : Token{TokenType::Invalid, "__invalid__", InternalNode{}};
-  m_next = (m_token_stream.size() >= m_index + 2)
-               ? m_token_stream[m_index + 1]
-               : Token{TokenType::Invalid, "__invalid__", InternalNode{}};
-  return m_previous;
+// token checking, no side effects.
+bool Parser::check_next(TokenType token_type) const {
+  return peek(1).type == token_type;
 }
 
 // consume a token if the type matches.
-std::optional<Token> Parser::consume_if(TokenType token_type) {
-  if (check_current(token_type))
-    return consume_token();
-  return std::nullopt;
+Token const *Parser::consume_if(TokenType token_type) {
+  if (!check_current(token_type))
+    return nullptr;
+  return &m_token_stream[m_index++];
+}
+
+ASTNodeId Parser::push_node(ASTObject ast_object) {
+  m_ast.nodes.push_back(std::move(ast_object));
+  return m_ast.nodes.size() - 1;
+}
+
+Origin Parser::node_origin(ASTNodeId id) const {
+  return std::visit(ASTVisitOrigin{}, m_ast.nodes[id]);
 }
 
 // parses the entire token stream.
 AST Parser::parse_tokens() {
-  AST ast;
   while (!check_current(TokenType::Invalid)) {
+    if (parse_import())
+      continue;
     std::optional<Field> field = parse_field();
     if (field) {
-      ast.fields.push_back(*field);
+      m_ast.fields.push_back(std::move(*field));
       continue;
     }
     std::optional<Task> task = parse_task();
     if (task) {
-      ast.tasks.push_back(*task);
+      m_ast.tasks.push_back(std::move(*task));
       continue;
     }
-    ErrorHandler::push_error_throw(m_current.origin, P_NO_MATCH);
+    ErrorHandler::push_error_throw(peek().origin, P_NO_MATCH);
+  }
+  return std::move(m_ast);
+}
+
+// attempts to parse an import. note: imports are resolved by the loader.
+bool Parser::parse_import() {
+  Token const *import_token = consume_if(TokenType::Import);
+  if (!import_token)
+    return false;
+  Token const *path_token = consume_if(TokenType::FormattedLiteral);
+  if (!path_token)
+    ErrorHandler::push_error_throw(import_token->origin,
+                                   P_IMPORT_INVALID_PATH);
+  // the path may only consist of a single literal.
+  Token const *path = consume_if(TokenType::Literal);
+  if (std::get<CTX_LEN>(*path_token->context) != 1 || !path ||
+      std::get<CTX_STR>(*path->context).empty())
+    ErrorHandler::push_error_throw(path_token->origin, P_IMPORT_INVALID_PATH);
+  m_ast.imports.push_back(
+      {std::get<CTX_STR>(*path->context), import_token->origin});
+  if (!consume_if(TokenType::LineStop))
+    ErrorHandler::push_error_throw(import_token->origin, P_FIELD_NO_LINESTOP);
+  return true;
+}
+
+// appends another AST, e.g. from an imported file. node ids of the other
+// AST are offset to point into the merged pool.
+void AST::merge(AST &&other) {
+  ASTNodeId node_offset = nodes.size();
+  uint32_t children_offset = children.size();
+  for (ASTObject &node : other.nodes) {
+    if (std::holds_alternative<FormattedLiteral>(node))
+      std::get<FormattedLiteral>(node).contents_begin += children_offset;
+    else if (std::holds_alternative<List>(node))
+      std::get<List>(node).contents_begin += children_offset;
+    else if (std::holds_alternative<Replace>(node)) {
+      Replace &replace = std::get<Replace>(node);
+      replace.identifier += node_offset;
+      replace.original += node_offset;
+      replace.replacement += node_offset;
+    }
+    nodes.push_back(std::move(node));
+  }
+  for (ASTNodeId child : other.children)
+    children.push_back(child + node_offset);
+  for (Field &field : other.fields) {
+    field.expression += node_offset;
+    fields.push_back(std::move(field));
+  }
+  for (Task &task : other.tasks) {
+    task.identifier += node_offset;
+    for (Field &field : task.fields)
+      field.expression += node_offset;
+    tasks.push_back(std::move(task));
   }
-  return AST(ast);
 }
 
 // attempts to parse a field.
@@ -115,13 +141,13 @@ std::optional<Field> Parser::parse_field() {
     return std::nullopt;
 
   Field field;
-  Token identifier_token = consume_token();
-  field.identifier = Identifier{std::get<CTX_STR>(*identifier_token.context),
-                                identifier_token.origin};
-  field.origin = identifier_token.origin;
-  consume_token(); // consume the `=`.
+  Token const *identifier_token = consume_if(TokenType::Identifier);
+  field.identifier = Identifier{std::get<CTX_STR>(*identifier_token->context),
+                                identifier_token->origin};
+  field.origin = identifier_token->origin;
+  consume_if(TokenType::Equals);
 
-  std::optional<ASTObject> ast_object = parse_ast_object();
+  std::optional<ASTNodeId> ast_object = parse_ast_object();
   if (!ast_object)
     ErrorHandler::push_error_throw(field.origin, P_FIELD_NO_EXPR);
 
@@ -133,14 +159,14 @@ std::optional<Field> Parser::parse_field() {
 
 // attempts to parse a task.
 std::optional<Task> Parser::parse_task() {
-  std::optional<ASTObject> identifier = parse_ast_object();
+  std::optional<ASTNodeId> identifier = parse_ast_object();
   Identifier iterator = ITERATOR_INTERNAL;
   if (!identifier)
     return std::nullopt;
-  Origin origin = std::visit(ASTVisitOrigin{}, *identifier);
+  Origin origin = node_origin(*identifier);
   // check if an explicit iterator name has been declared.
   if (consume_if(TokenType::IterateAs)) {
-    std::optional<Token> iterator_token = consume_if(TokenType::Identifier);
+    Token const *iterator_token = consume_if(TokenType::Identifier);
     if (!iterator_token)
       ErrorHandler::push_error_throw(origin, P_TASK_NO_ITERATOR);
     iterator = Identifier{std::get<CTX_STR>(*iterator_token->context),
@@ -156,7 +182,7 @@ std::optional<Task> Parser::parse_task() {
 
   std::optional<Field> field;
   while ((field = parse_field()))
-    task.fields.push_back(*field);
+    task.fields.push_back(std::move(*field));
 
   if (!consume_if(TokenType::TaskClose))
     ErrorHandler::push_error_throw(origin, P_TASK_NO_CLOSE);
@@ -174,98 +200,104 @@ std::optional<Task> Parser::parse_task() {
  *            token_true | token_false | ("[" ASTOBJ "]")
  */
 
-std::optional<ASTObject> Parser::parse_ast_object() { return parse_list(); }
-
-// recursive descent parser, see grammar.
-std::optional<ASTObject> Parser::parse_list() {
-  List list;
-  list.origin = InternalNode{};
-  std::optional<ASTObject> ast_obj;
-  ast_obj = parse_replace();
-  while (ast_obj && consume_if(TokenType::Separator)) {
-    if (std::holds_alternative<InternalNode>(list.origin))
-      list.origin = std::visit(ASTVisitOrigin{}, *ast_obj);
-    list.contents.push_back(*ast_obj);
-    ast_obj = parse_ast_object();
-  }
+std::optional<ASTNodeId> Parser::parse_ast_object() { return parse_list(); }
 
-  if (!ast_obj && !list.contents.empty())
-    ErrorHandler::push_error_throw(
-        std::visit(ASTVisitOrigin{}, list.contents[0]), P_AST_INVALID_END);
-  else if (!ast_obj && list.contents.empty())
+// lists are parsed iteratively. the elements are collected on a stack that
+// is shared with any nested lists, and only then copied into the AST.
+std::optional<ASTNodeId> Parser::parse_list() {
+  std::optional<ASTNodeId> ast_obj = parse_replace();
+  if (!ast_obj)
     return std::nullopt;
+  if (!check_current(TokenType::Separator))
+    return ast_obj;
+
+  size_t pending_begin = m_pending.size();
+  m_pending.push_back(*ast_obj);
+  while (consume_if(TokenType::Separator)) {
+    ast_obj = parse_replace();
+    if (!ast_obj)
+      ErrorHandler::push_error_throw(node_origin(m_pending[pending_begin]),
+                                     P_AST_INVALID_END);
+    m_pending.push_back(*ast_obj);
+  }
 
-  list.contents.push_back(*ast_obj);
-  if (std::holds_alternative<InternalNode>(list.origin))
-    list.origin = std::visit(ASTVisitOrigin{}, *ast_obj);
-
-  if (list.contents.size() == 1)
-    return list.contents[0];
-
-  return list;
+  List list;
+  list.origin = node_origin(m_pending[pending_begin]);
+  list.contents_begin = m_ast.children.size();
+  list.contents_size = m_pending.size() - pending_begin;
+  m_ast.children.insert(m_ast.children.end(),
+                        m_pending.begin() + pending_begin, m_pending.end());
+  m_pending.resize(pending_begin);
+  return push_node(std::move(list));
 }
 
 // recursive descent parser, see grammar.
-std::optional<ASTObject> Parser::parse_replace() {
-  std::optional<ASTObject> identifier = parse_primary();
+std::optional<ASTNodeId> Parser::parse_replace() {
+  std::optional<ASTNodeId> identifier = parse_primary();
   if (!consume_if(TokenType::Modify))
     return identifier; // not a replace.
-  Origin origin = std::visit(ASTVisitOrigin{}, *identifier);
+  if (!identifier)
+    ErrorHandler::push_error_throw(peek().origin, P_AST_INVALID_REPLACE);
+  Origin origin = node_origin(*identifier);
 
-  std::optional<ASTObject> original = parse_primary();
+  std::optional<ASTNodeId> original = parse_primary();
   if (!consume_if(TokenType::Arrow))
     ErrorHandler::push_error_throw(origin, P_AST_NO_ARROW);
 
-  std::optional<ASTObject> replacement = parse_primary();
-  if (!identifier || !original || !replacement)
+  std::optional<ASTNodeId> replacement = parse_primary();
+  if (!original || !replacement)
     ErrorHandler::push_error_throw(origin, P_AST_INVALID_REPLACE);
 
-  return Replace{
-      std::make_shared<ASTObject>(*identifier),
-      std::make_shared<ASTObject>(*original),
-      std::make_shared<ASTObject>(*replacement),
-      origin,
-  };
+  return push_node(Replace{*identifier, *original, *replacement, origin});
 }
 
 // recursive descent parser, see grammar.
-std::optional<ASTObject> Parser::parse_primary() {
-  std::optional<Token> token;
+std::optional<ASTNodeId> Parser::parse_primary() {
+  Token const *token;
   if ((token = consume_if(TokenType::Literal)))
-    return Literal{std::get<CTX_STR>(*token->context), token->origin};
+    return push_node(
+        Literal{std::get<CTX_STR>(*token->context), token->origin});
   else if ((token = consume_if(TokenType::Identifier)))
-    return Identifier{std::get<CTX_STR>(*token->context), token->origin};
+    return push_node(
+        Identifier{std::get<CTX_STR>(*token->context), token->origin});
   else if ((token = consume_if(TokenType::True)))
-    return Boolean{true, token->origin};
+    return push_node(Boolean{true, token->origin});
   else if ((token = consume_if(TokenType::False)))
-    return Boolean{false, token->origin};
+    return push_node(Boolean{false, token->origin});
   else if ((token = consume_if(TokenType::FormattedLiteral))) {
+    // the contents follow the literal, and always begin with a literal.
+    uint32_t contents_size = std::get<CTX_LEN>(*token->context);
+    Token const *internal_token_stream = &m_token_stream[m_index];
+    m_index += contents_size;
     FormattedLiteral formattedLiteral;
-    std::vector<Token> internal_token_stream =
-        std::get<CTX_VEC>(*token->context);
     formattedLiteral.origin = internal_token_stream[0].origin;
+    formattedLiteral.contents_size = contents_size;
     // note: only identifiers and literals may be present.
-    for (size_t i = 0; i < internal_token_stream.size(); i++) {
-      Token internal_token = internal_token_stream[i];
+    ASTNodeId contents_begin = m_ast.nodes.size();
+    for (uint32_t i = 0; i < contents_size; i++) {
+      Token const &internal_token = internal_token_stream[i];
       if (internal_token.type == TokenType::Literal)
-        formattedLiteral.contents.push_back(Literal{
-            std::get<CTX_STR>(*internal_token.context), internal_token.origin});
+        push_node(Literal{std::get<CTX_STR>(*internal_token.context),
+                          internal_token.origin});
       else if (internal_token.type == TokenType::Identifier)
-        formattedLiteral.contents.push_back(Identifier{
-            std::get<CTX_STR>(*internal_token.context), internal_token.origin});
+        push_node(Identifier{std::get<CTX_STR>(*internal_token.context),
+                             internal_token.origin});
       else
         ErrorHandler::push_error_throw(internal_token.origin,
                                        P_AST_INVALID_ESCAPE);
     }
-    return formattedLiteral;
+    formattedLiteral.contents_begin = m_ast.children.size();
+    for (size_t i = 0; i < contents_size; i++)
+      m_ast.children.push_back(contents_begin + i);
+    return push_node(std::move(formattedLiteral));
   } else if ((token = consume_if(TokenType::ExpressionOpen))) {
-    std::optional<ASTObject> ast_object = parse_ast_object();
-    if (!consume_if(TokenType::ExpressionClose))
-      ErrorHandler::push_error_throw(std::visit(ASTVisitOrigin{}, *ast_object),
-                                     P_AST_NO_CLOSE);
-    if (!ast_object)
+    std::optional<ASTNodeId> ast_object = parse_ast_object();
+    if (!ast_object) {
       ErrorHandler::push_error(token->origin, P_EMPTY_EXPRESSION);
-
+      ErrorHandler::push_error_throw(token->origin, P_AST_NO_CLOSE);
+    }
+    if (!consume_if(TokenType::ExpressionClose))
+      ErrorHandler::push_error_throw(node_origin(*ast_object), P_AST_NO_CLOSE);
     return ast_object;
   }
 
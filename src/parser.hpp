@@ -1,115 +1,106 @@
 #ifndef PARSER_H
 #define PARSER_H
 #include "lexer.hpp"
-#include <memory>
+#include <cstdint>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
-struct Identifier;
-struct Literal;
-struct FormattedLiteral;
-struct List;
-struct Boolean;
-struct Replace;
-using ASTObject =
-    std::variant<Identifier, Literal, FormattedLiteral, List, Boolean, Replace>;
+// index of a node in the AST's node pool.
+using ASTNodeId = uint32_t;
 
 // Logic: Expressions
+// note: strings are borrowed from the input buffer, and nested objects are
+// referenced by their index in the AST.
 struct Identifier {
-  std::string content;
+  std::string_view content;
   Origin origin;
-
-  bool operator==(Identifier const &other) const;
 };
 struct Literal {
-  std::string content;
+  std::string_view content;
   Origin origin;
-
-  bool operator==(Literal const &other) const;
 };
 struct FormattedLiteral {
-  std::vector<ASTObject> contents;
+  uint32_t contents_begin; // range in AST::children.
+  uint32_t contents_size;
   Origin origin;
-
-  bool operator==(FormattedLiteral const &other) const;
 };
 struct Boolean {
   bool content;
   Origin origin;
-
-  bool operator==(Boolean const &other) const;
 };
 struct List {
-  std::vector<ASTObject> contents;
+  uint32_t contents_begin; // range in AST::children.
+  uint32_t contents_size;
   Origin origin;
-
-  bool operator==(List const &other) const;
 };
 struct Replace {
-  std::shared_ptr<ASTObject> identifier;
-  std::shared_ptr<ASTObject> original;
-  std::shared_ptr<ASTObject> replacement;
+  ASTNodeId identifier;
+  ASTNodeId original;
+  ASTNodeId replacement;
   Origin origin;
-
-  bool operator==(Replace const &other) const;
 };
+using ASTObject =
+    std::variant<Identifier, Literal, FormattedLiteral, List, Boolean, Replace>;
 
 // Config: Fields, tasks, AST
 struct Field {
   Identifier identifier;
-  ASTObject expression;
+  ASTNodeId expression;
   Origin origin;
-
-  auto operator==(Field const &other) const {
-    return this->identifier == other.identifier &&
-           this->expression == other.expression;
-  }
 };
 struct Task {
-  ASTObject identifier;
+  ASTNodeId identifier;
   Identifier iterator;
   std::vector<Field> fields;
   Origin origin;
-
-  auto operator==(Task const &other) const {
-    return this->identifier == other.identifier &&
-           this->iterator == other.iterator && this->fields == other.fields;
-  }
+};
+struct Import {
+  std::string_view path; // relative to the importing file.
+  Origin origin;
 };
 struct AST {
+  std::vector<ASTObject> nodes;    // every expression, in a flat pool.
+  std::vector<ASTNodeId> children; // contents of lists and literals.
   std::vector<Field> fields;
   std::vector<Task> tasks;
+  std::vector<Import> imports;
   // delete the copy constructor to emphasize performance.
   explicit AST(AST const &) = default;
+  AST(AST &&) = default;
+  AST &operator=(AST &&) = default;
   AST() = default;
+
+  ASTObject const &operator[](ASTNodeId id) const { return nodes[id]; }
+  void merge(AST &&other);
 };
 
 // Work class
 class Parser {
 private:
-  std::vector<Token> m_token_stream;
+  std::vector<Token> const &m_token_stream;
   AST m_ast;
-
+  std::vector<ASTNodeId> m_pending; // children of the lists being parsed.
   size_t m_index;
-  Token m_previous;
-  Token m_current;
-  Token m_next;
 
-  Token consume_token();
-  Token consume_token(int n);
-  std::optional<Token> consume_if(TokenType token_type);
-  bool check_current(TokenType token_type);
-  bool check_next(TokenType token_type);
-  std::optional<ASTObject> parse_ast_object();
-  std::optional<ASTObject> parse_list();
-  std::optional<ASTObject> parse_replace();
-  std::optional<ASTObject> parse_primary();
+  Token const &peek(size_t offset = 0) const;
+  Token const *consume_if(TokenType token_type);
+  bool check_current(TokenType token_type) const;
+  bool check_next(TokenType token_type) const;
+  ASTNodeId push_node(ASTObject ast_object);
+  Origin node_origin(ASTNodeId id) const;
+  std::optional<ASTNodeId> parse_ast_object();
+  std::optional<ASTNodeId> parse_list();
+  std::optional<ASTNodeId> parse_replace();
+  std::optional<ASTNodeId> parse_primary();
   std::optional<Field> parse_field();
   std::optional<Task> parse_task();
+  bool parse_import();
 
 public:
-  Parser(std::vector<Token> token_stream);
+  Parser(std::vector<Token> const &token_stream);
   AST parse_tokens();
 };
 
@@ -0,0 +1,214 @@
+#include "paths.hpp"
+#include "oslayer.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// entries are stored in fixed-size chunks, the same way as origins.
+#define PATH_CHUNK_BITS 14
+#define PATH_CHUNK_SIZE (1u << PATH_CHUNK_BITS)
+#define PATH_MAX_CHUNKS (1u << 18)
+// the lookup table is split into shards, each with its own lock, so that
+// threads interning different paths rarely wait on each other.
+#define PATH_SHARDS 64
+#define PATH_SHARD_MIN_SLOTS 64
+#define PATH_BLOCK_SIZE (64 * 1024)
+
+// the timestamp of a path is cached in the lower bits of its stamp, where 0
+// means it hasn't been checked and 1 that the file doesn't exist. the upper
+// bits count invalidations, so that a stale stat can't overwrite them.
+#define STAMP_VALUE_BITS 48
+#define STAMP_VALUE_MASK ((uint64_t(1) << STAMP_VALUE_BITS) - 1)
+#define STAMP_UNKNOWN 0
+#define STAMP_MISSING 1
+
+struct PathEntry {
+  std::string_view path;
+  std::atomic<uint64_t> stamp{STAMP_UNKNOWN};
+};
+
+// every shard is an open addressing table of ids, tagged with the upper half
+// of their hash. 0 marks an empty slot.
+struct PathShard {
+  std::mutex lock;
+  std::vector<uint64_t> slots;
+  size_t count = 0;
+  char *block = nullptr; // the strings themselves are never moved.
+  size_t block_left = 0;
+};
+
+static std::atomic<PathEntry *> path_chunks[PATH_MAX_CHUNKS];
+static std::atomic<uint32_t> next_path = 1;
+static std::mutex chunk_lock;
+static PathShard shards[PATH_SHARDS];
+
+static PathEntry &entry(uint32_t id) {
+  return path_chunks[id >> PATH_CHUNK_BITS].load(
+      std::memory_order_acquire)[id & (PATH_CHUNK_SIZE - 1)];
+}
+
+// returns the slot of a path, which is empty if it hasn't been interned.
+// note: has to be called with the shard locked.
+static uint64_t &find_slot(PathShard &shard, std::string_view path,
+                           uint32_t tag) {
+  size_t mask = shard.slots.size() - 1;
+  for (size_t i = tag & mask;; i = (i + 1) & mask) {
+    uint64_t &slot = shard.slots[i];
+    if (slot == 0 || ((slot >> 32) == tag &&
+                      entry(uint32_t(slot)).path == path))
+      return slot;
+  }
+}
+
+static void grow(PathShard &shard) {
+  std::vector<uint64_t> slots(
+      std::max<size_t>(shard.slots.size() * 2, PATH_SHARD_MIN_SLOTS), 0);
+  std::swap(slots, shard.slots);
+  size_t mask = shard.slots.size() - 1;
+  for (uint64_t slot : slots) {
+    if (slot == 0)
+      continue;
+    size_t i = (slot >> 32) & mask;
+    while (shard.slots[i] != 0)
+      i = (i + 1) & mask;
+    shard.slots[i] = slot;
+  }
+}
+
+// copies a path into the storage of its shard, null-terminated.
+static std::string_view store(PathShard &shard, std::string_view path) {
+  char *out;
+  if (path.size() + 1 > PATH_BLOCK_SIZE / 4) {
+    out = new char[path.size() + 1];
+  } else {
+    if (shard.block_left < path.size() + 1) {
+      shard.block = new char[PATH_BLOCK_SIZE];
+      shard.block_left = PATH_BLOCK_SIZE;
+    }
+    out = shard.block;
+    shard.block += path.size() + 1;
+    shard.block_left -= path.size() + 1;
+  }
+  std::memcpy(out, path.data(), path.size());
+  out[path.size()] = '\0';
+  return std::string_view(out, path.size());
+}
+
+PathId::PathId(std::string_view path) {
+  if (path.empty())
+    return;
+  size_t hash = std::hash<std::string_view>()(path);
+  uint32_t tag = uint32_t(uint64_t(hash) >> 32);
+  PathShard &path_shard = shards[hash % PATH_SHARDS];
+  std::lock_guard<std::mutex> guard(path_shard.lock);
+  // kept at most half full.
+  if ((path_shard.count + 1) * 2 > path_shard.slots.size())
+    grow(path_shard);
+  uint64_t &slot = find_slot(path_shard, path, tag);
+  if (slot != 0) {
+    this->id = uint32_t(slot);
+    return;
+  }
+
+  uint32_t id = next_path.fetch_add(1, std::memory_order_relaxed);
+  // note: the chunks cover every 32-bit id.
+  uint32_t chunk = id >> PATH_CHUNK_BITS;
+  PathEntry *entries = path_chunks[chunk].load(std::memory_order_acquire);
+  if (!entries) {
+    std::lock_guard<std::mutex> chunk_guard(chunk_lock);
+    entries = path_chunks[chunk].load(std::memory_order_relaxed);
+    if (!entries) {
+      entries = new PathEntry[PATH_CHUNK_SIZE];
+      path_chunks[chunk].store(entries, std::memory_order_release);
+    }
+  }
+  entries[id & (PATH_CHUNK_SIZE - 1)].path = store(path_shard, path);
+  slot = uint64_t(tag) << 32 | id;
+  path_shard.count++;
+  this->id = id;
+}
+
+std::optional<PathId> PathId::find(std::string_view path) {
+  if (path.empty())
+    return PathId();
+  size_t hash = std::hash<std::string_view>()(path);
+  uint32_t tag = uint32_t(uint64_t(hash) >> 32);
+  PathShard &path_shard = shards[hash % PATH_SHARDS];
+  std::lock_guard<std::mutex> guard(path_shard.lock);
+  if (path_shard.slots.empty())
+    return std::nullopt;
+  uint64_t slot = find_slot(path_shard, path, tag);
+  if (slot == 0)
+    return std::nullopt;
+  PathId path_id;
+  path_id.id = uint32_t(slot);
+  return path_id;
+}
+
+std::string_view PathId::view() const {
+  if (id == 0)
+    return {};
+  return entry(id).path;
+}
+
+std::optional<size_t> PathId::timestamp() const {
+  if (id == 0)
+    return std::nullopt;
+  std::atomic<uint64_t> &stamp = entry(id).stamp;
+  uint64_t current = stamp.load(std::memory_order_acquire);
+  uint64_t value = current & STAMP_VALUE_MASK;
+  if (value != STAMP_UNKNOWN)
+    Stats::add(Counter::StatCacheHits);
+  if (value == STAMP_MISSING)
+    return std::nullopt;
+  if (value != STAMP_UNKNOWN)
+    return value - 2;
+
+  // note: stored paths are null-terminated.
+  TraceSpan span("stat", view());
+  std::optional<size_t> timestamp =
+      OSLayer::get_file_timestamp(view().data());
+  span.end();
+  value = timestamp ? ((*timestamp + 2) & STAMP_VALUE_MASK) : STAMP_MISSING;
+  // fails if the path was invalidated in the meantime, in which case the
+  // result is used once but not cached.
+  stamp.compare_exchange_strong(current, current | value,
+                                std::memory_order_acq_rel);
+  return timestamp;
+}
+
+static void invalidate_stamp(std::atomic<uint64_t> &stamp) {
+  uint64_t current = stamp.load(std::memory_order_relaxed);
+  while (!stamp.compare_exchange_weak(
+      current, (current & ~STAMP_VALUE_MASK) + (uint64_t(1) << STAMP_VALUE_BITS),
+      std::memory_order_acq_rel))
+    ;
+}
+
+void PathId::invalidate() const {
+  if (id == 0)
+    return;
+  invalidate_stamp(entry(id).stamp);
+}
+
+// note: ids are handed out before their chunk is allocated, so the chunks
+// are visited instead. paths that are interned in the meantime can't have
+// been stat'ed yet. stamps that are being checked are invalidated too,
+// since the stat may have been taken before the file was modified.
+void PathId::invalidate_all() {
+  uint32_t end = next_path.load(std::memory_order_acquire);
+  for (uint32_t chunk = 0; chunk <= (end - 1) >> PATH_CHUNK_BITS; chunk++) {
+    PathEntry *entries = path_chunks[chunk].load(std::memory_order_acquire);
+    if (!entries)
+      continue;
+    for (uint32_t i = 0; i < PATH_CHUNK_SIZE; i++)
+      invalidate_stamp(entries[i].stamp);
+  }
+}
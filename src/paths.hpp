@@ -0,0 +1,34 @@
+#ifndef PATHS_H
+#define PATHS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// task iterations and dependencies are interned into a global table, so that
+// each distinct path is stored once and compared, hashed and indexed as a
+// 32-bit id. the table also caches the timestamp of every path, which is
+// invalidated once a task has written it.
+// note: like origins, the table is never cleared.
+struct PathId {
+  uint32_t id = 0; // 0 is always the empty path.
+
+  PathId() = default;
+  explicit PathId(std::string_view path);
+  // looks up a path without interning it.
+  static std::optional<PathId> find(std::string_view path);
+
+  std::string_view view() const;
+  // stats the path once and caches the result.
+  std::optional<size_t> timestamp() const;
+  // has to be called whenever the file might have been modified.
+  void invalidate() const;
+  // has to be called whenever any file might have been modified.
+  static void invalidate_all();
+
+  bool operator==(PathId const &other) const { return id == other.id; }
+  bool operator!=(PathId const &other) const { return id != other.id; }
+};
+
+#endif
@@ -0,0 +1,122 @@
+#include "report.hpp"
+#include "format.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+static std::string format_seconds(double seconds) {
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.2fs", seconds);
+  return buffer;
+}
+
+static std::string format_kib(size_t kib) {
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.1f MiB", kib / 1024.0);
+  return buffer;
+}
+
+BuildReport::BuildReport(Setup setup)
+    : m_setup(setup), m_start(std::chrono::steady_clock::now()) {}
+
+void BuildReport::add_task(PathId task, ResourceUsage const &usage) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_tasks.push_back({task, usage});
+}
+
+void BuildReport::finish() {
+  m_wall = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         m_start)
+               .count();
+}
+
+ResourceUsage BuildReport::total() const {
+  ResourceUsage total;
+  for (TaskUsage const &task : m_tasks) {
+    total.user += task.usage.user;
+    total.system += task.usage.system;
+    total.max_rss = std::max(total.max_rss, task.usage.max_rss);
+    total.commands += task.usage.commands;
+  }
+  total.wall = m_wall;
+  return total;
+}
+
+std::vector<TaskUsage> BuildReport::slowest() const {
+  std::vector<TaskUsage> tasks = m_tasks;
+  std::stable_sort(tasks.begin(), tasks.end(),
+                   [](TaskUsage const &a, TaskUsage const &b) {
+                     return a.usage.wall > b.usage.wall;
+                   });
+  return tasks;
+}
+
+// note: the parallelism is the cpu time per second of the build, and the
+// efficiency is the share of the available cores that it kept busy.
+void BuildReport::print() {
+  std::lock_guard<std::mutex> guard(m_lock);
+  ResourceUsage usage = total();
+  double cpu = usage.user + usage.system;
+  double parallelism = usage.wall > 0 ? cpu / usage.wall : 0;
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  char efficiency[64];
+  std::snprintf(efficiency, sizeof(efficiency),
+                "%.2fx parallelism (%.0f%% of %u cores)", parallelism,
+                100 * parallelism / cores, cores);
+
+  LOG_STANDARD("⧗ build summary");
+  LOG_STANDARD("  " << usage.commands << " command(s) in " << m_tasks.size()
+                    << " task(s), " << format_seconds(usage.wall)
+                    << " wall, " << format_seconds(cpu) << " cpu ("
+                    << format_seconds(usage.user) << " user, "
+                    << format_seconds(usage.system) << " sys)");
+  LOG_STANDARD("  " << efficiency << ", " << format_kib(usage.max_rss)
+                    << " peak rss");
+  if (m_tasks.empty())
+    return;
+  LOG_STANDARD("  slowest tasks:");
+  std::vector<TaskUsage> tasks = slowest();
+  for (size_t i = 0; i < tasks.size() && i < REPORT_SLOWEST_TASKS; i++) {
+    ResourceUsage const &task = tasks[i].usage;
+    char wall[32];
+    std::snprintf(wall, sizeof(wall), "%9s",
+                  format_seconds(task.wall).c_str());
+    LOG_STANDARD("  " << wall << "  " << tasks[i].task.view() << " ("
+                      << format_seconds(task.user + task.system) << " cpu, "
+                      << format_kib(task.max_rss) << ")");
+  }
+}
+
+static void write_usage(std::ostream &out, ResourceUsage const &usage) {
+  out << "\"wall\":" << usage.wall << ",\"user\":" << usage.user
+      << ",\"system\":" << usage.system << ",\"max_rss_kib\":" << usage.max_rss
+      << ",\"commands\":" << usage.commands;
+}
+
+// every task is listed, slowest first.
+bool BuildReport::write_json(std::string const &path) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file)
+    return false;
+  ResourceUsage usage = total();
+  file << "{";
+  write_usage(file, usage);
+  file << ",\"parallelism\":"
+       << (usage.wall > 0 ? (usage.user + usage.system) / usage.wall : 0)
+       << ",\"cores\":" << std::max(1u, std::thread::hardware_concurrency())
+       << ",\"tasks\":[";
+  std::vector<TaskUsage> tasks = slowest();
+  for (size_t i = 0; i < tasks.size(); i++) {
+    file << (i == 0 ? "\n" : ",\n") << "{\"task\":";
+    write_json_string(file, tasks[i].task.view());
+    file << ",";
+    write_usage(file, tasks[i].usage);
+    file << "}";
+  }
+  file << "\n]}\n";
+  file.close();
+  return !file.fail();
+}
@@ -0,0 +1,43 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include "driver.hpp"
+#include "oslayer.hpp"
+#include "paths.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// number of tasks listed in the summary.
+#define REPORT_SLOWEST_TASKS 10
+
+struct TaskUsage {
+  PathId task;
+  ResourceUsage usage;
+};
+
+// the resources used by the commands of every task iteration, summarised at
+// the end of the build (`--summary`, `--summary-json=<file>`).
+class BuildReport {
+private:
+  Setup m_setup;
+  std::chrono::steady_clock::time_point m_start;
+  double m_wall = 0;
+  std::vector<TaskUsage> m_tasks;
+  std::mutex m_lock;
+
+  ResourceUsage total() const;
+  std::vector<TaskUsage> slowest() const;
+
+public:
+  BuildReport(Setup setup);
+  void add_task(PathId task, ResourceUsage const &usage);
+  // stops the build's clock.
+  void finish();
+  void print();
+  bool write_json(std::string const &path);
+};
+
+#endif
@@ -0,0 +1,36 @@
+#include "stats.hpp"
+
+#include <atomic>
+
+bool Stats::s_enabled = false;
+
+static std::array<std::atomic<uint64_t>, (size_t)Counter::_Count> totals;
+
+// merged into the totals when the thread exits.
+struct ThreadCounters {
+  Counters counters = {};
+  ~ThreadCounters() {
+    for (size_t i = 0; i < counters.size(); i++)
+      totals[i].fetch_add(counters[i], std::memory_order_relaxed);
+  }
+};
+
+Counters &Stats::local() {
+  static thread_local ThreadCounters thread_counters;
+  return thread_counters.counters;
+}
+
+void Stats::enable() { s_enabled = true; }
+
+// the counters of the calling thread are merged as well, and reset so that
+// they aren't counted again when it exits.
+Counters Stats::collect() {
+  Counters &counters = local();
+  Counters merged;
+  for (size_t i = 0; i < merged.size(); i++) {
+    merged[i] = totals[i].load(std::memory_order_relaxed) + counters[i];
+    counters[i] = 0;
+    totals[i].store(merged[i], std::memory_order_relaxed);
+  }
+  return merged;
+}
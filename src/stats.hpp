@@ -0,0 +1,47 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+enum class Counter : size_t {
+  ValueCacheHits,
+  ValueCacheMisses,
+  IterationCacheHits,
+  IterationCacheMisses,
+  StatCalls,
+  StatCacheHits,
+  Globs,
+  GlobEntries,
+  TaskLookups,
+  EvaluationLocks,
+  EvaluationWaitNs,
+  ThreadsSpawned,
+  CommandsRun,
+  _Count,
+};
+
+using Counters = std::array<uint64_t, (size_t)Counter::_Count>;
+
+// internal counters, shown with `--stats`. every thread counts into its own
+// counters, which are merged into the global ones when it exits.
+// note: counting is disabled unless enabled before the build starts, in
+// which case a counter costs a single branch.
+class Stats {
+private:
+  static bool s_enabled;
+  static Counters &local();
+
+public:
+  static void enable();
+  static bool enabled() { return s_enabled; }
+  static void add(Counter counter, uint64_t amount = 1) {
+    if (s_enabled)
+      local()[(size_t)counter] += amount;
+  }
+  // note: every other thread has to have exited.
+  static Counters collect();
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include "trace.hpp"
+#include "format.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifndef WIN32
+#include <unistd.h>
+#else
+#include <process.h>
+#define getpid _getpid
+#endif
+
+struct TraceEvent {
+  char const *name;
+  std::string detail;
+  uint64_t begin; // nanoseconds since tracing was enabled.
+  uint64_t duration;
+};
+
+struct TraceThread {
+  uint32_t id;
+  std::vector<TraceEvent> events;
+};
+
+bool Trace::s_enabled = false;
+
+// threads are registered on their first event, and their buffers are kept
+// until the trace is written, since worker threads don't outlive their task.
+static std::mutex trace_lock;
+static std::vector<std::unique_ptr<TraceThread>> trace_threads;
+static thread_local TraceThread *current_thread = nullptr;
+static std::chrono::steady_clock::time_point trace_start;
+
+static uint64_t now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - trace_start)
+      .count();
+}
+
+static TraceThread &thread_buffer() {
+  if (!current_thread) {
+    std::lock_guard<std::mutex> guard(trace_lock);
+    trace_threads.push_back(std::make_unique<TraceThread>());
+    trace_threads.back()->id = trace_threads.size();
+    current_thread = trace_threads.back().get();
+  }
+  return *current_thread;
+}
+
+// has to be called before any other thread is started.
+void Trace::enable() {
+  trace_start = std::chrono::steady_clock::now();
+  s_enabled = true;
+  thread_buffer(); // the main thread is always the first.
+}
+
+// note: every thread has to be joined before the trace is written.
+bool Trace::write(std::string const &path) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file)
+    return false;
+  std::lock_guard<std::mutex> guard(trace_lock);
+  long pid = getpid();
+  // timestamps are in microseconds.
+  char timestamp[64];
+  bool first = true;
+  file << "{\"traceEvents\":[";
+  for (std::unique_ptr<TraceThread> const &thread : trace_threads) {
+    file << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\","
+         << "\"pid\":" << pid << ",\"tid\":" << thread->id
+         << ",\"args\":{\"name\":\""
+         << (thread->id == 1 ? "main" : "worker") << "\"}}";
+    first = false;
+    for (TraceEvent const &event : thread->events) {
+      std::snprintf(timestamp, sizeof(timestamp),
+                    "\"ts\":%.3f,\"dur\":%.3f", event.begin / 1000.0,
+                    event.duration / 1000.0);
+      file << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\","
+           << timestamp << ",\"pid\":" << pid << ",\"tid\":" << thread->id;
+      if (!event.detail.empty()) {
+        file << ",\"args\":{\"detail\":";
+        write_json_string(file, event.detail);
+        file << "}";
+      }
+      file << "}";
+    }
+  }
+  file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  file.close();
+  return !file.fail();
+}
+
+TraceSpan::TraceSpan(char const *name, std::string_view detail,
+                     uint64_t min_duration)
+    : m_name(name), m_begin(0), m_min_duration(min_duration),
+      m_active(Trace::enabled()) {
+  if (!m_active)
+    return;
+  if (detail.size() > TRACE_DETAIL_LIMIT)
+    m_detail = std::string(detail.substr(0, TRACE_DETAIL_LIMIT)) + "...";
+  else
+    m_detail = detail;
+  m_begin = now();
+}
+
+void TraceSpan::end() {
+  if (!m_active)
+    return;
+  m_active = false;
+  uint64_t duration = now() - m_begin;
+  if (duration < m_min_duration)
+    return;
+  thread_buffer().events.push_back(
+      {m_name, std::move(m_detail), m_begin, duration});
+}
@@ -0,0 +1,47 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// details longer than this are cut off, e.g. for very long commands.
+#define TRACE_DETAIL_LIMIT 1024
+// lock waits shorter than this aren't worth recording.
+#define TRACE_MIN_WAIT_NS 10000
+
+// records spans of the build as chrome trace events (`--trace=file.json`),
+// which can be opened in chrome://tracing or perfetto. every thread records
+// into its own buffer, and the buffers are only merged when written.
+// note: recording is disabled unless enabled before the build starts, in
+// which case a span costs a single branch.
+class Trace {
+private:
+  static bool s_enabled;
+
+public:
+  static void enable();
+  static bool enabled() { return s_enabled; }
+  static bool write(std::string const &path);
+};
+
+// records its own lifetime as a complete event on the current thread.
+class TraceSpan {
+private:
+  char const *m_name;
+  std::string m_detail;
+  uint64_t m_begin;
+  uint64_t m_min_duration;
+  bool m_active;
+
+public:
+  TraceSpan(char const *name, std::string_view detail = {},
+            uint64_t min_duration = 0);
+  ~TraceSpan() { end(); }
+  TraceSpan(TraceSpan const &) = delete;
+  TraceSpan &operator=(TraceSpan const &) = delete;
+  // ends the span early.
+  void end();
+};
+
+#endif
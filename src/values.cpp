@@ -0,0 +1,140 @@
+#include "values.hpp"
+#include "errors.hpp"
+
+// constructors & casts for internal data types.
+IString::IString() {
+  this->origin = InternalNode{};
+  this->content = "";
+}
+IString::IString(Token const &token) {
+  if (token.type != TokenType::Literal)
+    ErrorHandler::push_error_throw(token.origin,
+                                   _I_CONSTRUCTOR_EXPECTED_LITERAL);
+  this->origin = token.origin;
+  this->content = std::get<CTX_STR>(*token.context);
+};
+IString::IString(std::string_view content, Origin origin) {
+  this->origin = origin;
+  this->content = content;
+}
+std::string IString::toString() const { return std::string(this->content); };
+std::string_view IString::view() const { return this->content; };
+bool IString::operator==(IString const &other) const {
+  return this->content == other.content;
+}
+
+IBool::IBool() {
+  this->origin = InternalNode{};
+  this->content = false;
+}
+IBool::IBool(Token const &token) {
+  if (token.type != TokenType::True && token.type != TokenType::False)
+    ErrorHandler::push_error_throw(token.origin, _I_CONSTRUCTOR_EXPECTED_BOOL);
+  this->origin = token.origin;
+  this->content = (token.type == TokenType::True);
+}
+IBool::IBool(bool content, Origin origin) {
+  this->origin = origin;
+  this->content = content;
+}
+bool IBool::operator==(IBool const &other) const {
+  return this->content == other.content;
+}
+IBool::operator bool() const { return (this->content); };
+
+IString IStringList::operator[](size_t index) const {
+  IString string(contents[index], origins[index]);
+  if (!expansions.empty())
+    string.expansions = expansions[index];
+  return string;
+}
+void IStringList::reserve(size_t size) {
+  contents.reserve(size);
+  origins.reserve(size);
+}
+void IStringList::push_back(IString const &string) {
+  if (string.expansions && expansions.empty())
+    expansions.resize(contents.size(), nullptr);
+  contents.push_back(string.content);
+  origins.push_back(string.origin);
+  if (!expansions.empty())
+    expansions.push_back(string.expansions);
+}
+void IStringList::append(IStringList const &other) {
+  if (!other.expansions.empty() && expansions.empty())
+    expansions.resize(contents.size(), nullptr);
+  contents.insert(contents.end(), other.contents.begin(),
+                  other.contents.end());
+  origins.insert(origins.end(), other.origins.begin(), other.origins.end());
+  if (!other.expansions.empty())
+    expansions.insert(expansions.end(), other.expansions.begin(),
+                      other.expansions.end());
+  else if (!expansions.empty())
+    expansions.resize(contents.size(), nullptr);
+}
+
+IBool IBoolList::operator[](size_t index) const {
+  return IBool(contents[index], origins[index]);
+}
+void IBoolList::reserve(size_t size) {
+  contents.reserve(size);
+  origins.reserve(size);
+}
+void IBoolList::push_back(IBool const &boolean) {
+  contents.push_back(boolean.content);
+  origins.push_back(boolean.origin);
+}
+void IBoolList::append(IBoolList const &other) {
+  contents.insert(contents.end(), other.contents.begin(),
+                  other.contents.end());
+  origins.insert(origins.end(), other.origins.begin(), other.origins.end());
+}
+
+// all empty lists share the same contents.
+static std::shared_ptr<const IListContents> const empty_list_contents =
+    std::make_shared<const IListContents>(IStringList());
+
+IList::IList() {
+  this->origin = InternalNode{};
+  this->contents = empty_list_contents;
+}
+IList::IList(IListContents contents) {
+  if (std::holds_alternative<IStringList>(contents)) {
+    IStringList const &contents_qbstring = std::get<IStringList>(contents);
+    if (contents_qbstring.size() <= 0)
+      ErrorHandler::push_error_throw(InternalNode{},
+                                     _I_CONSTRUCTOR_EXPECTED_NONEMPTY);
+    this->origin = contents_qbstring.origins[0];
+  } else if (std::holds_alternative<IBoolList>(contents)) {
+    IBoolList const &contents_qbbool = std::get<IBoolList>(contents);
+    if (contents_qbbool.size() <= 0)
+      ErrorHandler::push_error_throw(InternalNode{},
+                                     _I_CONSTRUCTOR_EXPECTED_NONEMPTY);
+    this->origin = contents_qbbool.origins[0];
+  }
+  this->contents = std::make_shared<const IListContents>(std::move(contents));
+}
+// note: unlike the above, this allows for empty lists.
+IList::IList(IListContents contents, Origin origin) {
+  this->origin = origin;
+  this->contents = std::make_shared<const IListContents>(std::move(contents));
+}
+bool IList::holds_qbstring() const {
+  return (this->contents->index() == QBLIST_STR);
+}
+bool IList::holds_qbbool() const {
+  return (this->contents->index() == QBLIST_BOOL);
+}
+IStringList const &IList::strings() const {
+  return std::get<QBLIST_STR>(*this->contents);
+}
+IBoolList const &IList::bools() const {
+  return std::get<QBLIST_BOOL>(*this->contents);
+}
+size_t IList::size() const {
+  return holds_qbstring() ? strings().size() : bools().size();
+}
+bool IList::operator==(IList const &other) const {
+  return this->contents == other.contents ||
+         *this->contents == *other.contents;
+}
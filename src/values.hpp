@@ -0,0 +1,120 @@
+#ifndef VALUES_H
+#define VALUES_H
+
+#include "lexer.hpp"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+// range of an interpolated string that was expanded from a list.
+struct IExpansion {
+  size_t begin;
+  size_t end;
+};
+
+// note: the contents are owned by either the AST or the interpreter's arena.
+struct IString {
+  Origin origin;
+  std::string_view content;
+  // only recorded for strings long enough to need a response file.
+  std::vector<IExpansion> const *expansions = nullptr;
+
+  std::string toString() const;
+  std::string_view view() const;
+  IString();
+  IString(Token const &);
+  IString(std::string_view, Origin);
+  bool operator==(IString const &other) const;
+};
+
+struct IBool {
+  Origin origin;
+  bool content;
+  IBool();
+  IBool(Token const &);
+  IBool(bool, Origin);
+  operator bool() const;
+  bool operator==(IBool const &other) const;
+};
+
+#define QBLIST_STR 0
+#define QBLIST_BOOL 1
+
+// iterates over a list by value, elements are assembled on the fly.
+template <typename List, typename Value> struct IListIterator {
+  List const *list;
+  size_t index;
+  Value operator*() const { return (*list)[index]; }
+  IListIterator &operator++() {
+    index++;
+    return *this;
+  }
+  bool operator!=(IListIterator const &other) const {
+    return index != other.index;
+  }
+};
+
+// lists are stored as parallel arrays rather than as arrays of values, so
+// that scanning the contents of a list doesn't touch the origins.
+struct IStringList {
+  std::vector<std::string_view> contents;
+  std::vector<Origin> origins;
+  // only allocated once an element that has expansions is added.
+  std::vector<std::vector<IExpansion> const *> expansions;
+
+  size_t size() const { return contents.size(); }
+  bool empty() const { return contents.empty(); }
+  IString operator[](size_t index) const;
+  void reserve(size_t size);
+  void push_back(IString const &string);
+  void append(IStringList const &other);
+  IListIterator<IStringList, IString> begin() const { return {this, 0}; }
+  IListIterator<IStringList, IString> end() const { return {this, size()}; }
+  bool operator==(IStringList const &other) const {
+    return contents == other.contents;
+  }
+};
+
+struct IBoolList {
+  std::vector<bool> contents; // packed into a bitset.
+  std::vector<Origin> origins;
+
+  size_t size() const { return contents.size(); }
+  bool empty() const { return contents.empty(); }
+  IBool operator[](size_t index) const;
+  void reserve(size_t size);
+  void push_back(IBool const &boolean);
+  void append(IBoolList const &other);
+  IListIterator<IBoolList, IBool> begin() const { return {this, 0}; }
+  IListIterator<IBoolList, IBool> end() const { return {this, size()}; }
+  bool operator==(IBoolList const &other) const {
+    return contents == other.contents;
+  }
+};
+
+using IListContents = std::variant<IStringList, IBoolList>;
+
+// evaluated lists are immutable, so copies share the same contents and
+// passing a list around is O(1) regardless of its length.
+struct IList {
+  Origin origin;
+  std::shared_ptr<const IListContents> contents;
+  bool holds_qbstring() const;
+  bool holds_qbbool() const;
+  IStringList const &strings() const;
+  IBoolList const &bools() const;
+  size_t size() const;
+  IList();
+  IList(IListContents);
+  IList(IListContents, Origin);
+  bool operator==(IList const &other) const;
+};
+
+struct IValue {
+  std::variant<IString, IBool, IList> value;
+  bool immutable = true;
+};
+
+#endif